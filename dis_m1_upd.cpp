@@ -5,6 +5,37 @@
 #include <vector>
 #include <regex>
 #include <algorithm>
+#include <cstdint>
+#include <cctype>
+#include <thread>
+#include <random>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <list>
+#include <unordered_map>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <filesystem>
+#include <chrono>
+#include <limits>
+#include <type_traits>
+#include <cmath>
+#include <memory>
+#include <map>
+#include <cstring>
+#include <cerrno>
+#include "set_store.h"
+#include "int_sets.h"
+#if defined(__unix__) || defined(__APPLE__)
+#define SETS_SHARED_MEMORY 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#endif
 
 /*
 Команды:
@@ -19,514 +50,2914 @@
 8) A & B – вычислить пересечение множеств A и B слиянием;
 9) A - B – вычислить разность множеств A и B слиянием;
 10) A < B – проверить, является ли A подмножеством B слиянием;
-11) A = B – проверить, равны ли множества A и B.
+11) A = B – проверить, равны ли множества A и B;
+12) see A [x..y] – вывести элементы множества A из диапазона [x, y];
+13) rank A x – число элементов множества A, меньших x;
+14) select A k – k-й по возрастанию элемент множества A (с нуля);
+15) rel r A B – создать пустое отношение r ⊆ A×B;
+16) prod r A B – создать отношение r = A×B;
+17) pair r x y – добавить пару (x, y) в отношение r;
+18) comp t r s – t = композиция отношений r и s;
+19) clos t r – t = транзитивное замыкание r;
+20) props r – проверить рефлексивность, симметричность и транзитивность r;
+21) see r / del r – вывести / удалить отношение r;
+22) pow A k=m – все подмножества A из m элементов (если их не больше 65536);
+23) pow A #i, pow A #i..j – подмножества A с номерами i..j в комбинаторном порядке
+    (не больше 65536 за раз);
+24) pow A rank B – номер подмножества B в булеане A;
+25) pow A sample m – m случайных подмножеств A (m не больше 65536);
+26) mem [A] – память, занимаемая множествами (список и сжатые представления);
+27) new $A, add $A s1 s2 ..., rem $A s, see $A, del $A, $A + $B и т.д. – множества строк,
+    строки кодируются номерами общего словаря;
+28) dict – статистика словаря строк и память множеств строк;
+29) new %A, add %A 1 2 ..., add %A x..y[/s], see %A, del %A, %A + %B и т.д. – множества целых
+    на диске (во временном каталоге); %C = %A + %B сохраняет результат;
+30) cache – статистика кэша результатов операций;
+31) has A xyz... – пакетная проверка принадлежности элементов x, y, z... множеству A,
+    результат – битовая маска;
+32) bench [n] – сравнение скорости ядер слияния (обычное, векторное, галоп) на массивах
+    из n элементов и последовательного слияния с параллельным (SortedSet);
+33) trace on / trace off / trace save file – запись интервалов выполнения команд
+    (разбор, поиск множеств, операция, вывод) и сохранение в формате Chrome trace;
+34) snap – снимок всех множеств A-Z, получает номер текущей версии @vN; snaps – список
+    снимков, drop @vN – освободить снимок. see [A] @vN, A + B @vN и т.д. – запросы к версии N,
+    пока она удерживается снимком;
+35) share name – публиковать множества A-Z в разделяемой памяти /name (единственный писатель,
+    каждое изменение публикуется атомарно); attach name – подключиться к ней только для чтения
+    из другого процесса, detach – отключиться; see *, see *A, *A + *B и т.д. – запросы
+    к последней опубликованной версии. Сегмент, брошенный аварийно завершившимся писателем,
+    share освобождает сам; сегмент с неизвестной раскладкой удаляется вручную (rm /dev/shm/name).
+
+Запуск с ключом --pipeline выполняет команды из стандартного ввода конвейером.
+--workload [seed=1] [commands=100000] [sets=8] [size=24] [skew=1.0] [mix=new:2,add:40,rem:15,see:15,op:25,pow:3]
+генерирует воспроизводимый поток команд и замеряет его выполнение (команды в секунду,
+перцентили задержки); с --emit только выводит поток. --replay file замеряет команды из файла.
+
+Для встраивания в другую программу ядро вынесено в set_store.h / set_store.cpp и собирается
+статической библиотекой set_store (CMakeLists.txt): класс SetStore даёт операции над
+множествами A-Z с кодами результата, без вывода на консоль и без исключений.
 */
 
-class Node {
+//ленивые представления операций над множествами: элементы вычисляются слиянием
+//во время обхода, новое множество не создаётся
+enum ViewKind { VIEW_UNION, VIEW_INTERSECTION, VIEW_DIFFERENCE };
+
+//представление существующего множества
+class SetRef {
+private:
+    const Set* set;
+
 public:
-    char data;
-    Node* next;
+    typedef Set::const_iterator iterator;
+
+    SetRef(const Set& source) : set(&source) {}
 
-    Node(char value) : data(value), next(nullptr) {}
-    ~Node() {}
+    iterator begin() const {
+        return set->begin();
+    }
+
+    iterator end() const {
+        return set->end();
+    }
 };
 
-class Set {
+template <ViewKind Kind, typename A, typename B>
+class MergeView {
 private:
-    std::string name;
-    Node* first;
+    A left;
+    B right;
 
-    void checkName(const std::string& n) {
-        if (n.empty()) {
-            throw std::invalid_argument("The name of the set should not be empty.");
+public:
+    typedef typename A::iterator LeftIterator;
+    typedef typename B::iterator RightIterator;
+
+    class iterator {
+    private:
+        LeftIterator a, aEnd;
+        RightIterator b, bEnd;
+
+        //сдвигает курсоры к ближайшему элементу результата
+        void settle() {
+            if (Kind == VIEW_INTERSECTION) {
+                while (a != aEnd && b != bEnd && *a != *b) {
+                    if (*a < *b) ++a;
+                    else ++b;
+                }
+                if (a == aEnd || b == bEnd) {
+                    a = aEnd;
+                    b = bEnd;
+                }
+            }
+            else if (Kind == VIEW_DIFFERENCE) {
+                while (a != aEnd) {
+                    while (b != bEnd && *b < *a) ++b;
+                    if (b == bEnd || *b != *a) break;
+                    ++a;
+                    ++b;
+                }
+                if (a == aEnd) b = bEnd;
+            }
         }
 
-        if (n.length() != 1 || n[0] < 'A' || n[0] > 'Z') {
-            throw std::invalid_argument("The name of the set must be a single character in the A-Z range");
+    public:
+        iterator(LeftIterator aBegin, LeftIterator aLast, RightIterator bBegin, RightIterator bLast)
+            : a(aBegin), aEnd(aLast), b(bBegin), bEnd(bLast) {
+            settle();
         }
-    }
 
-    void clear() {
-        Node* current = first;
-        while (current != nullptr) {
-            Node* next = current->next;
-            delete current;
-            current = next;
+        char operator*() const {
+            if (Kind == VIEW_UNION) {
+                if (a == aEnd) return *b;
+                if (b == bEnd) return *a;
+                return std::min(*a, *b);
+            }
+            return *a;
         }
-        first = nullptr;
-    }
 
-    void copyFrom(const Set& other) {
-        Node* otherCurrent = other.first;
-        Node* last = nullptr;
-
-        while (otherCurrent != nullptr) {
-            Node* newNode = new Node(otherCurrent->data);
-
-            if (last == nullptr) {
-                first = newNode;
+        iterator& operator++() {
+            if (Kind == VIEW_UNION) {
+                if (b == bEnd || (a != aEnd && *a < *b)) {
+                    ++a;
+                }
+                else if (a == aEnd || *b < *a) {
+                    ++b;
+                }
+                else {
+                    ++a;
+                    ++b;
+                }
+            }
+            else if (Kind == VIEW_INTERSECTION) {
+                ++a;
+                ++b;
             }
             else {
-                last->next = newNode;
+                ++a;
             }
-            last = newNode;
-            otherCurrent = otherCurrent->next;
+            settle();
+            return *this;
         }
-    }
 
-public:
-    Set(const std::string& setName) : first(nullptr) {
-        checkName(setName);
-        name = setName;
-    }
+        bool operator==(const iterator& other) const {
+            return a == other.a && b == other.b;
+        }
 
-    Set(const Set& other) : name(other.name), first(nullptr) {
-        copyFrom(other);
+        bool operator!=(const iterator& other) const {
+            return !(*this == other);
+        }
+    };
+
+    MergeView(const A& leftView, const B& rightView) : left(leftView), right(rightView) {}
+
+    iterator begin() const {
+        return iterator(left.begin(), left.end(), right.begin(), right.end());
     }
 
-    Set& operator=(const Set& other) {
-        if (this != &other) {
-            clear();
-            name = other.name;
-            copyFrom(other);
-        }
-        return *this;
+    iterator end() const {
+        return iterator(left.end(), left.end(), right.end(), right.end());
     }
+};
+
+inline SetRef asView(const Set& set) {
+    return SetRef(set);
+}
+
+//вложенные представления хранятся по значению: они содержат лишь указатели на множества
+template <ViewKind Kind, typename A, typename B>
+MergeView<Kind, A, B> asView(const MergeView<Kind, A, B>& view) {
+    return view;
+}
+
+template <typename A, typename B>
+auto unionView(const A& a, const B& b) -> MergeView<VIEW_UNION, decltype(asView(a)), decltype(asView(b))> {
+    return MergeView<VIEW_UNION, decltype(asView(a)), decltype(asView(b))>(asView(a), asView(b));
+}
+
+template <typename A, typename B>
+auto intersectView(const A& a, const B& b) -> MergeView<VIEW_INTERSECTION, decltype(asView(a)), decltype(asView(b))> {
+    return MergeView<VIEW_INTERSECTION, decltype(asView(a)), decltype(asView(b))>(asView(a), asView(b));
+}
+
+template <typename A, typename B>
+auto differenceView(const A& a, const B& b) -> MergeView<VIEW_DIFFERENCE, decltype(asView(a)), decltype(asView(b))> {
+    return MergeView<VIEW_DIFFERENCE, decltype(asView(a)), decltype(asView(b))>(asView(a), asView(b));
+}
 
-    ~Set() {
-        clear();
+//вывод битовой карты в формате Set::print
+inline void printBits(std::ostream& out, const std::string& name, const Set::Bitmap& bits) {
+    TraceSpan span("print");
+    out << name << " = {";
+    bool firstElement = true;
+    for (int element = bits.next(0); element != -1; element = bits.next(element + 1)) {
+        if (!firstElement) out << ", ";
+        out << static_cast<char>(element);
+        firstElement = false;
     }
+    out << "}" << std::endl;
+}
 
-    std::string getName() const {
-        return name;
+//вывод в формате Set::print без построения множества
+template <typename View>
+void printView(std::ostream& out, const std::string& name, const View& view) {
+    TraceSpan span("print");
+    out << name << " = {";
+    bool firstElement = true;
+    for (char element : view) {
+        if (!firstElement) out << ", ";
+        out << element;
+        firstElement = false;
     }
+    out << "}" << std::endl;
+}
 
-    void setName(const std::string& newName) {
-        checkName(newName);
-        name = newName;
+//сравнение ядер слияния на случайных отсортированных массивах: для каждого размера элемента
+//и соотношения размеров входов выводится скорость (млн элементов входа в секунду)
+template <typename T>
+void benchmarkSortedKernels(std::ostream& out, const char* typeName, size_t size, std::mt19937_64& rng) {
+    typedef SortedKernels<T> Kernels;
+    typedef typename Kernels::Kernel Kernel;
+    //значения берутся из диапазона вчетверо шире входа, чтобы пересечение не было пустым
+    uint64_t domain = uint64_t(4) * size;
+    if (std::numeric_limits<T>::digits < 64) {
+        domain = std::min(domain, uint64_t(1) << std::numeric_limits<T>::digits);
+    }
+    auto generate = [&](size_t count) {
+        std::vector<T> values(count);
+        for (T& value : values) value = static_cast<T>(rng() % domain);
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+        return values;
+    };
+    const size_t large = std::min<uint64_t>(size, domain / 2);
+    const char* blockName = Kernels::blockKernels().name;
+
+    for (size_t ratio : { size_t(1), size_t(1000) }) {
+        std::vector<T> a = generate(large);
+        std::vector<T> b = generate(std::max<size_t>(1, large / ratio));
+        std::vector<T> result(a.size() + b.size());
+        //каждое ядро обрабатывает около 2^24 элементов входа
+        size_t repeats = std::max<size_t>(1, (size_t(1) << 24) / (a.size() + b.size()));
+
+        auto measure = [&](Kernel kernel, size_t& count) {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t r = 0; r < repeats; r++) {
+                count = kernel(a.data(), a.size(), b.data(), b.size(), result.data());
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return double(repeats) * (a.size() + b.size()) / std::max(seconds, 1e-9) / 1e6;
+        };
+        auto row = [&](const char* operation, std::vector<std::pair<std::string, Kernel>> kernels) {
+            out << "  " << typeName << " " << a.size() << ":" << b.size() << " " << operation;
+            size_t expected = 0;
+            for (size_t k = 0; k < kernels.size(); k++) {
+                size_t count = 0;
+                double speed = measure(kernels[k].second, count);
+                if (k == 0) expected = count;
+                out << "  " << kernels[k].first << " " << static_cast<long long>(speed) << " M/s";
+                if (count != expected) out << " (MISMATCH)";
+            }
+            out << "\n";
+        };
+
+        row("union", { { "scalar", Kernels::scalarUnion }, { "gallop", Kernels::gallopUnion } });
+        row("intersection", { { "scalar", Kernels::scalarIntersection },
+            { blockName, Kernels::blockKernels().intersection }, { "gallop", Kernels::gallopIntersection } });
+        row("difference", { { "scalar", Kernels::scalarDifference },
+            { blockName, Kernels::blockKernels().difference }, { "gallop", Kernels::gallopDifference } });
     }
+}
 
-    void addElement(char element) {
-        if (element < 32 || element > 126) {
-            throw std::invalid_argument("Element must be a printable character");
+//последовательное слияние (подсчёт и запись одним потоком) против SortedSet, который
+//выше PARALLEL_THRESHOLD делит входы на части и сливает их в пуле потоков
+inline void benchmarkSortedSets(std::ostream& out, size_t size, std::mt19937_64& rng) {
+    typedef SortedKernels<uint32_t> Kernels;
+    auto generate = [&]() {
+        std::vector<uint32_t> values(size);
+        for (uint32_t& value : values) value = static_cast<uint32_t>(rng() % (uint64_t(4) * size));
+        return SortedSet(std::move(values));
+    };
+    SortedSet setA = generate();
+    SortedSet setB = generate();
+    const std::vector<uint32_t>& a = setA.getValues();
+    const std::vector<uint32_t>& b = setB.getValues();
+    size_t repeats = std::max<size_t>(1, (size_t(1) << 24) / (a.size() + b.size()));
+
+    auto speed = [&](std::chrono::steady_clock::time_point start) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return static_cast<long long>(double(repeats) * (a.size() + b.size()) / std::max(seconds, 1e-9) / 1e6);
+    };
+    auto row = [&](const char* operation, Kernels::Kernel kernel, SortedSet (*parallel)(const SortedSet&, const SortedSet&)) {
+        size_t expected = 0, count = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < repeats; r++) {
+            std::vector<uint32_t> result(kernel(a.data(), a.size(), b.data(), b.size(), nullptr));
+            expected = kernel(a.data(), a.size(), b.data(), b.size(), result.data());
+        }
+        long long sequential = speed(start);
+        start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < repeats; r++) {
+            count = parallel(setA, setB).getSize();
         }
+        out << "  uint32 " << a.size() << ":" << b.size() << " " << operation << "  sequential " << sequential
+            << " M/s  parallel " << speed(start) << " M/s";
+        if (count != expected) out << " (MISMATCH)";
+        out << "\n";
+    };
+
+    out << "Sorted sets, " << WorkPool::instance().getThreads() << " thread(s), parallel from "
+        << SortedSet::PARALLEL_THRESHOLD << " input elements:\n";
+    row("union", Kernels::unionOf, SortedSet::unionSets);
+    row("intersection", Kernels::intersection, SortedSet::intersection);
+    row("difference", Kernels::difference, SortedSet::difference);
+}
+
+inline void benchmarkSortedKernels(std::ostream& out, size_t size) {
+    std::mt19937_64 rng{ 42 };
+    out << "Merge kernels, million input elements per second:\n";
+    benchmarkSortedKernels<uint8_t>(out, "uint8", size, rng);
+    benchmarkSortedKernels<uint16_t>(out, "uint16", size, rng);
+    benchmarkSortedKernels<uint32_t>(out, "uint32", size, rng);
+    benchmarkSortedKernels<uint64_t>(out, "uint64", size, rng);
+    benchmarkSortedSets(out, size, rng);
+    out.flush();
+}
 
-        Node* newNode = new Node(element);
+//множество целых на диске: отсортированные серии (runs) в файлах и буфер в памяти;
+//буфер сбрасывается в новую серию, а при избытке серий они сливаются в одну (как в LSM-дереве).
+//операции читают серии блоками по BLOCK значений, поэтому память ограничена
+//независимо от размера множеств
+class DiskSet {
+public:
+    static const size_t BLOCK = size_t(1) << 14;
+    static const size_t BUFFER_LIMIT = size_t(1) << 20;
+    static const size_t TIER_FANOUT = 4;
 
-        if (first == nullptr || element < first->data) {
-            newNode->next = first;
-            first = newNode;
-            return;
+private:
+    //последовательное чтение серии блоками
+    class RunReader {
+    private:
+        std::ifstream file;
+        std::vector<uint32_t> block;
+        size_t position = 0;
+
+        void refill() {
+            block.resize(BLOCK);
+            file.read(reinterpret_cast<char*>(block.data()), BLOCK * sizeof(uint32_t));
+            block.resize(static_cast<size_t>(file.gcount()) / sizeof(uint32_t));
+            position = 0;
         }
 
-        if (element == first->data) {
-            delete newNode;
-            return;
+    public:
+        explicit RunReader(const std::string& path) : file(path, std::ios::binary) {
+            if (!file) {
+                throw std::runtime_error("Cannot open run file " + path);
+            }
+            refill();
         }
 
-        Node* current = first;
-        while (current->next != nullptr && current->next->data < element) {
-            current = current->next;
+        bool atEnd() const {
+            return position >= block.size();
         }
 
-        if (current->next != nullptr && current->next->data == element) {
-            delete newNode;
-            return;
+        uint32_t value() const {
+            return block[position];
         }
 
-        newNode->next = current->next;
-        current->next = newNode;
-    }
+        void advance() {
+            if (++position >= block.size()) refill();
+        }
 
-    void removeElement(char element) {
-        if (first == nullptr) return;
+        void skipTo(uint32_t target) {
+            while (!atEnd() && block.back() < target) {
+                refill();
+            }
+            if (!atEnd()) {
+                position = std::lower_bound(block.begin() + position, block.end(), target) - block.begin();
+            }
+        }
+    };
+
+    //запись серии блоками
+    //ошибка записи бросает исключение; серия, не дошедшая до close(), удаляется деструктором,
+    //поэтому прежние серии остаются на месте
+    class RunWriter {
+    private:
+        std::string path;
+        std::ofstream file;
+        std::vector<uint32_t> block;
+        size_t count = 0;
+        bool closed = false;
+
+        void flush() {
+            file.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(uint32_t));
+            block.clear();
+            if (!file) {
+                throw std::runtime_error("Cannot write run file " + path);
+            }
+        }
 
-        if (first->data == element) {
-            Node* temp = first;
-            first = first->next;
-            delete temp;
-            return;
+    public:
+        explicit RunWriter(const std::string& runPath) : path(runPath), file(runPath, std::ios::binary | std::ios::trunc) {
+            if (!file) {
+                throw std::runtime_error("Cannot create run file " + path);
+            }
+            block.reserve(BLOCK);
         }
 
-        Node* current = first;
-        while (current->next != nullptr && current->next->data != element) {
-            current = current->next;
+        RunWriter(const RunWriter&) = delete;
+        RunWriter& operator=(const RunWriter&) = delete;
+
+        void push(uint32_t value) {
+            block.push_back(value);
+            count++;
+            if (block.size() == BLOCK) flush();
         }
 
-        if (current->next != nullptr && current->next->data == element) {
-            Node* temp = current->next;
-            current->next = current->next->next;
-            delete temp;
+        //число записанных значений
+        size_t close() {
+            flush();
+            file.close();
+            if (!file) {
+                throw std::runtime_error("Cannot close run file " + path);
+            }
+            closed = true;
+            return count;
         }
-    }
 
-    bool contains(char element) const {
-        Node* current = first;
-        while (current != nullptr) {
-            if (current->data == element) return true;
-            current = current->next;
+        ~RunWriter() {
+            if (!closed) {
+                file.close();
+                std::remove(path.c_str());
+            }
         }
-        return false;
+    };
+
+    std::string directory;
+    std::vector<std::string> runs;
+    std::vector<size_t> runSizes;   //число значений в каждой серии
+    std::vector<uint32_t> buffer;
+
+    std::string newRunPath() const {
+        static std::atomic<unsigned> counter{ 0 };
+        static const std::string token = std::to_string(std::random_device{}());
+        return directory + "/set_" + token + "_" + std::to_string(counter++) + ".run";
     }
 
-    int getSize() const {
-        int count = 0;
-        Node* current = first;
-        while (current != nullptr) {
-            count++;
-            current = current->next;
-        }
-        return count;
+    static std::vector<uint32_t> sortedUnique(std::vector<uint32_t> values) {
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+        return values;
     }
 
-    void print() const {
-        std::cout << name << " = {";
-        Node* current = first;
-        while (current != nullptr) {
-            std::cout << current->data;
-            if (current->next != nullptr) std::cout << ", ";
-            current = current->next;
+    void removeRuns() {
+        for (const auto& path : runs) {
+            std::remove(path.c_str());
         }
-        std::cout << "}" << std::endl;
+        runs.clear();
+        runSizes.clear();
     }
 
-    std::vector<char> getElements() const {
-        std::vector<char> elements;
-        Node* current = first;
-        while (current != nullptr) {
-            elements.push_back(current->data);
-            current = current->next;
+    //ярус серии: 0 – до BLOCK значений, каждый следующий в TIER_FANOUT раз больше
+    static int tierOf(size_t count) {
+        int tier = 0;
+        for (size_t limit = BLOCK; count > limit && tier < 32; limit *= TIER_FANOUT) {
+            tier++;
         }
-        return elements;
+        return tier;
     }
 
-    std::vector<Set> powerSet() const {
-        std::vector<Set> result;
-        std::vector<char> elements = getElements();
-        int n = elements.size();
-
-        // 2^n подмножеств
-        for (int i = 0; i < (1 << n); i++) {
-            Set subset("S");
-            for (int j = 0; j < n; j++) {
-                if (i & (1 << j)) {
-                    subset.addElement(elements[j]);
-                }
-            }
-            result.push_back(subset);
-        }
+    template <typename Merge>
+    static DiskSet mergeInto(const std::string& directory, Merge merge) {
+        DiskSet result(directory);
+        std::string path = result.newRunPath();
+        RunWriter writer(path);
+        merge([&](uint32_t value) { writer.push(value); });
+        result.runSizes.push_back(writer.close());
+        result.runs.push_back(path);
         return result;
     }
 
-    static Set unionSets(const Set& setA, const Set& setB) {
-        Set result("T");
+    //сброс буфера в новую серию; при ошибке записи буфер сохраняется
+    void spill() {
+        if (buffer.empty()) return;
+
+        std::sort(buffer.begin(), buffer.end());
+        buffer.erase(std::unique(buffer.begin(), buffer.end()), buffer.end());
+
+        std::string path = newRunPath();
+        RunWriter writer(path);
+        for (uint32_t value : buffer) {
+            writer.push(value);
+        }
+        runSizes.push_back(writer.close());
+        runs.push_back(path);
+        buffer.clear();
 
-        Node* currentA = setA.first;
-        Node* currentB = setB.first;
+        compact();
+    }
 
-        while (currentA != nullptr && currentB != nullptr) {
-            if (currentA->data < currentB->data) {
-                result.addElement(currentA->data);
-                currentA = currentA->next;
+    //уплотнение по ярусам: последние TIER_FANOUT серий одного яруса сливаются в одну серию
+    //следующего яруса. Значение переписывается не больше одного раза на ярус, а не при каждом
+    //уплотнении, как при слиянии всех серий; число серий растёт логарифмически
+    void compact() {
+        while (runs.size() >= TIER_FANOUT) {
+            size_t first = runs.size() - TIER_FANOUT;
+            int tier = tierOf(runSizes[first]);
+            bool sameTier = true;
+            for (size_t i = first + 1; i < runs.size(); i++) {
+                if (tierOf(runSizes[i]) != tier) sameTier = false;
             }
-            else if (currentB->data < currentA->data) {
-                result.addElement(currentB->data);
-                currentB = currentB->next;
+            if (!sameTier) break;
+
+            std::string path = newRunPath();
+            size_t count = 0;
+            {
+                RunWriter writer(path);
+                for (Cursor cursor(runs.begin() + first, runs.end()); !cursor.atEnd(); cursor.advance()) {
+                    writer.push(cursor.value());
+                }
+                count = writer.close();
             }
-            else {
-                result.addElement(currentA->data);
-                currentA = currentA->next;
-                currentB = currentB->next;
+            for (size_t i = first; i < runs.size(); i++) {
+                std::remove(runs[i].c_str());
             }
+            runs.resize(first);
+            runSizes.resize(first);
+            runs.push_back(path);
+            runSizes.push_back(count);
         }
+    }
 
-        while (currentA != nullptr) {
-            result.addElement(currentA->data);
-            currentA = currentA->next;
+public:
+    //курсор по всем сериям и буферу: значения по возрастанию без повторов
+    class Cursor {
+    private:
+        std::vector<RunReader> readers;
+        std::vector<uint32_t> memory;
+        size_t memoryPosition = 0;
+        bool finished = false;
+        uint32_t current = 0;
+
+        void settle() {
+            finished = true;
+            for (const auto& reader : readers) {
+                if (!reader.atEnd() && (finished || reader.value() < current)) {
+                    current = reader.value();
+                    finished = false;
+                }
+            }
+            if (memoryPosition < memory.size() && (finished || memory[memoryPosition] < current)) {
+                current = memory[memoryPosition];
+                finished = false;
+            }
         }
 
-        while (currentB != nullptr) {
-            result.addElement(currentB->data);
-            currentB = currentB->next;
+    public:
+        explicit Cursor(const DiskSet& set) : Cursor(set.runs.begin(), set.runs.end()) {
+            memory = sortedUnique(set.buffer);
+            settle();
         }
 
-        return result;
-    }
+        //только по указанным сериям, без буфера
+        Cursor(std::vector<std::string>::const_iterator first, std::vector<std::string>::const_iterator last) {
+            readers.reserve(last - first);
+            for (; first != last; ++first) {
+                readers.emplace_back(*first);
+            }
+            settle();
+        }
 
-    static Set intersection(const Set& setA, const Set& setB) {
-        Set result("T");
+        bool atEnd() const {
+            return finished;
+        }
 
-        Node* currentA = setA.first;
-        Node* currentB = setB.first;
+        uint32_t value() const {
+            return current;
+        }
 
-        while (currentA != nullptr && currentB != nullptr) {
-            if (currentA->data < currentB->data) {
-                currentA = currentA->next;
+        void advance() {
+            for (auto& reader : readers) {
+                if (!reader.atEnd() && reader.value() == current) reader.advance();
             }
-            else if (currentB->data < currentA->data) {
-                currentB = currentB->next;
+            if (memoryPosition < memory.size() && memory[memoryPosition] == current) {
+                memoryPosition++;
             }
-            else {
-                result.addElement(currentA->data);
-                currentA = currentA->next;
-                currentB = currentB->next;
+            settle();
+        }
+
+        void skipTo(uint32_t target) {
+            if (finished || current >= target) return;
+            for (auto& reader : readers) {
+                reader.skipTo(target);
             }
+            memoryPosition = std::lower_bound(memory.begin() + memoryPosition, memory.end(), target) - memory.begin();
+            settle();
         }
+    };
 
-        return result;
-    }
+    explicit DiskSet(const std::string& path) : directory(path) {}
 
-    static Set difference(const Set& setA, const Set& setB) {
-        Set result("T");
+    DiskSet(const DiskSet&) = delete;
+    DiskSet& operator=(const DiskSet&) = delete;
 
-        Node* currentA = setA.first;
-        Node* currentB = setB.first;
+    DiskSet(DiskSet&& other) noexcept
+        : directory(std::move(other.directory)), runs(std::move(other.runs)), runSizes(std::move(other.runSizes)),
+        buffer(std::move(other.buffer)) {
+        other.runs.clear();
+        other.runSizes.clear();
+    }
 
-        while (currentA != nullptr && currentB != nullptr) {
-            if (currentA->data < currentB->data) {
-                result.addElement(currentA->data);
-                currentA = currentA->next;
-            }
-            else if (currentB->data < currentA->data) {
-                currentB = currentB->next;
-            }
-            else {
-                currentA = currentA->next;
-                currentB = currentB->next;
-            }
+    DiskSet& operator=(DiskSet&& other) noexcept {
+        if (this != &other) {
+            removeRuns();
+            directory = std::move(other.directory);
+            runs = std::move(other.runs);
+            runSizes = std::move(other.runSizes);
+            buffer = std::move(other.buffer);
+            other.runs.clear();
+            other.runSizes.clear();
         }
+        return *this;
+    }
 
-        while (currentA != nullptr) {
-            result.addElement(currentA->data);
-            currentA = currentA->next;
-        }
+    ~DiskSet() {
+        removeRuns();
+    }
 
-        return result;
+    void addElement(uint32_t value) {
+        buffer.push_back(value);
+        if (buffer.size() >= BUFFER_LIMIT) spill();
     }
 
-    static bool isSubset(const Set& setA, const Set& setB) {
-        Node* currentA = setA.first;
-        Node* currentB = setB.first;
+    size_t getRunCount() const {
+        return runs.size();
+    }
 
-        while (currentA != nullptr && currentB != nullptr) {
-            if (currentA->data < currentB->data) {
-                return false;
-            }
-            else if (currentB->data < currentA->data) {
-                currentB = currentB->next;
-            }
-            else {
-                currentA = currentA->next;
-                currentB = currentB->next;
-            }
-        }
+    //вывод потоком, без загрузки множества в память
+    void print(std::ostream& out, const std::string& name) const {
+        out << name << " = ";
+        printElements(out);
+    }
 
-        return currentA == nullptr;
+    void printElements(std::ostream& out) const {
+        out << "{";
+        bool firstElement = true;
+        for (Cursor cursor(*this); !cursor.atEnd(); cursor.advance()) {
+            if (!firstElement) out << ", ";
+            out << cursor.value();
+            firstElement = false;
+        }
+        out << "}" << std::endl;
     }
 
-    static bool areEqual(const Set& setA, const Set& setB) {
-        Node* currentA = setA.first;
-        Node* currentB = setB.first;
+    static DiskSet unionSets(const DiskSet& setA, const DiskSet& setB) {
+        return mergeInto(setA.directory, [&](auto emit) {
+            mergeUnion(Cursor(setA), Cursor(setB), emit);
+        });
+    }
 
-        while (currentA != nullptr && currentB != nullptr) {
-            if (currentA->data != currentB->data) {
-                return false;
-            }
-            currentA = currentA->next;
-            currentB = currentB->next;
-        }
+    static DiskSet intersection(const DiskSet& setA, const DiskSet& setB) {
+        return mergeInto(setA.directory, [&](auto emit) {
+            mergeIntersection(Cursor(setA), Cursor(setB), emit);
+        });
+    }
 
-        return currentA == nullptr && currentB == nullptr;
+    static DiskSet difference(const DiskSet& setA, const DiskSet& setB) {
+        return mergeInto(setA.directory, [&](auto emit) {
+            mergeDifference(Cursor(setA), Cursor(setB), emit);
+        });
     }
-};
 
-class SetManager {
-private:
-    std::vector<Set> sets;
+    static bool isSubset(const DiskSet& setA, const DiskSet& setB) {
+        return mergeIsSubset(Cursor(setA), Cursor(setB));
+    }
 
-    int findSetIndex(const std::string& name) {
-        for (int i = 0; i < sets.size(); i++) {
-            if (sets[i].getName() == name) {
-                return i;
-            }
+    static bool areEqual(const DiskSet& setA, const DiskSet& setB) {
+        Cursor a(setA);
+        Cursor b(setB);
+        for (; !a.atEnd() && !b.atEnd(); a.advance(), b.advance()) {
+            if (a.value() != b.value()) return false;
         }
-        return -1;
+        return a.atEnd() && b.atEnd();
     }
+};
+
+//многоразовый барьер для фиксированного числа потоков
+class Barrier {
+private:
+    std::mutex mutex;
+    std::condition_variable released;
+    unsigned count;
+    unsigned waiting = 0;
+    uint64_t generation = 0;
 
 public:
-    void createSet(const std::string& name) {
-        if (findSetIndex(name) != -1) {
-            std::cout << "Set " << name << " already exists!" << std::endl;
+    explicit Barrier(unsigned threads) : count(threads) {}
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        uint64_t arrived = generation;
+        if (++waiting == count) {
+            waiting = 0;
+            generation++;
+            released.notify_all();
             return;
         }
-        sets.push_back(Set(name));
-        std::cout << "Set " << name << " created successfully." << std::endl;
+        released.wait(lock, [&] { return generation != arrived; });
     }
+};
 
-    void deleteSet(const std::string& name) {
-        int index = findSetIndex(name);
-        if (index == -1) {
-            std::cout << "Set " << name << " not found!" << std::endl;
-            return;
+//булева матрица, строки хранятся как битовые слова
+class BitMatrix {
+private:
+    //блок опорных строк в алгоритме Уоршелла – ровно одно слово строки
+    static const int BLOCK = 64;
+    //матрицы меньше этого порога обрабатываются в одном потоке
+    static const int PARALLEL_THRESHOLD = 512;
+
+    int rows;
+    int cols;
+    int words;
+    std::vector<uint64_t> data;
+
+    static void orRow(uint64_t* target, const uint64_t* source, int words) {
+        for (int w = 0; w < words; w++) {
+            target[w] |= source[w];
         }
-        sets.erase(sets.begin() + index);
-        std::cout << "Set " << name << " deleted successfully." << std::endl;
     }
 
-    void addElement(const std::string& setName, char element) {
-        int index = findSetIndex(setName);
-        if (index == -1) {
-            std::cout << "Set " << setName << " not found!" << std::endl;
-            return;
-        }
-        sets[index].addElement(element);
-        std::cout << "Element '" << element << "' added to set " << setName << std::endl;
+    //число потоков для обработки count строк; 1 – небольшая задача
+    static unsigned threadsFor(int count, int cost) {
+        unsigned threads = std::thread::hardware_concurrency();
+        if (cost < PARALLEL_THRESHOLD || threads < 2 || count < 2) return 1;
+        return std::min<unsigned>(threads, static_cast<unsigned>(count));
     }
 
-    void removeElement(const std::string& setName, char element) {
-        int index = findSetIndex(setName);
-        if (index == -1) {
-            std::cout << "Set " << setName << " not found!" << std::endl;
+    //выполняет body(from, to) над диапазонами строк [0, count) в нескольких потоках
+    template <typename Body>
+    static void parallelRows(int count, int cost, Body body) {
+        unsigned threads = threadsFor(count, cost);
+        if (threads == 1) {
+            body(0, count);
             return;
         }
-        sets[index].removeElement(element);
-        std::cout << "Element '" << element << "' removed from set " << setName << std::endl;
-    }
 
-    void showPowerSet(const std::string& setName) {
-        int index = findSetIndex(setName);
-        if (index == -1) {
-            std::cout << "Set " << setName << " not found!" << std::endl;
-            return;
+        std::vector<std::thread> workers;
+        int chunk = (count + threads - 1) / threads;
+        for (int from = chunk; from < count; from += chunk) {
+            workers.emplace_back(body, from, std::min(count, from + chunk));
+        }
+        body(0, std::min(count, chunk));
+        for (auto& worker : workers) {
+            worker.join();
         }
+    }
 
-        std::vector<Set> power = sets[index].powerSet();
-        std::cout << "Power set of " << setName << " (size: " << power.size() << "):" << std::endl;
-        for (size_t i = 0; i < power.size(); i++) {
-            std::cout << "  " << i + 1 << ". ";
-            power[i].print();
+public:
+    BitMatrix(int rowCount = 0, int colCount = 0)
+        : rows(rowCount), cols(colCount), words((colCount + 63) / 64),
+        data(static_cast<size_t>(rowCount) * ((colCount + 63) / 64), 0) {}
+
+    int getRows() const {
+        return rows;
+    }
+
+    int getCols() const {
+        return cols;
+    }
+
+    uint64_t* row(int i) {
+        return data.data() + static_cast<size_t>(i) * words;
+    }
+
+    const uint64_t* row(int i) const {
+        return data.data() + static_cast<size_t>(i) * words;
+    }
+
+    bool get(int i, int j) const {
+        return (row(i)[j >> 6] >> (j & 63)) & 1;
+    }
+
+    void set(int i, int j) {
+        row(i)[j >> 6] |= uint64_t(1) << (j & 63);
+    }
+
+    void fill() {
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols; j++) {
+                set(i, j);
+            }
         }
     }
 
-    void showSets(const std::string& setName = "") {
-        if (setName.empty()) {
-            if (sets.empty()) {
-                std::cout << "No sets available." << std::endl;
-                return;
+    //булево произведение: (i, j) есть, если i → k в a и k → j в b
+    static BitMatrix multiply(const BitMatrix& a, const BitMatrix& b) {
+        BitMatrix result(a.rows, b.cols);
+
+        parallelRows(a.rows, a.rows, [&](int from, int to) {
+            for (int i = from; i < to; i++) {
+                uint64_t* target = result.row(i);
+                const uint64_t* source = a.row(i);
+                for (int w = 0; w < a.words; w++) {
+                    for (uint64_t bitsLeft = source[w]; bitsLeft != 0; bitsLeft &= bitsLeft - 1) {
+                        orRow(target, b.row(w * 64 + lowestBit(bitsLeft)), b.words);
+                    }
+                }
             }
-            std::cout << "All sets (" << sets.size() << "):" << std::endl;
-            for (const auto& set : sets) {
-                set.print();
+        });
+        return result;
+    }
+
+    //замыкание опорных строк [k0, k1) между собой
+    void closePivotBlock(int k0, int k1) {
+        for (int k = k0; k < k1; k++) {
+            for (int i = k0; i < k1; i++) {
+                if (get(i, k)) orRow(row(i), row(k), words);
             }
         }
-        else {
-            int index = findSetIndex(setName);
-            if (index == -1) {
-                std::cout << "Set " << setName << " not found!" << std::endl;
-                return;
+    }
+
+    //строки [from, to) вне блока вбирают опорные строки, до которых дотягиваются
+    void absorbPivotBlock(int k0, int k1, int from, int to) {
+        int w = k0 / 64;
+        for (int i = from; i < to; i++) {
+            if (i >= k0 && i < k1) continue;
+
+            uint64_t* target = row(i);
+            uint64_t done = 0;
+            uint64_t pending;
+            while ((pending = target[w] & ~done) != 0) {
+                int k = w * 64 + lowestBit(pending);
+                done |= pending & (~pending + 1);
+                orRow(target, row(k), words);
             }
-            sets[index].print();
         }
     }
 
-    void performOperation(const std::string& operation, const std::string& setNameA, const std::string& setNameB) {
-        int indexA = findSetIndex(setNameA);
-        int indexB = findSetIndex(setNameB);
+    //транзитивное замыкание по Уоршеллу: опорные строки обрабатываются блоками
+    //по 64, блок остаётся в кэше, пока через него проходят все остальные строки.
+    //Потоки создаются один раз на всё замыкание: у каждого свой диапазон строк,
+    //блоки разделяются двумя барьерами (опорные строки готовы / все строки обработаны)
+    void transitiveClosure() {
+        if (rows != cols) {
+            throw std::invalid_argument("Transitive closure requires a square matrix");
+        }
 
-        if (indexA == -1 || indexB == -1) {
-            std::cout << "One or both sets not found!" << std::endl;
+        unsigned threads = threadsFor(rows, rows);
+        if (threads == 1) {
+            for (int k0 = 0; k0 < rows; k0 += BLOCK) {
+                int k1 = std::min(rows, k0 + BLOCK);
+                closePivotBlock(k0, k1);
+                absorbPivotBlock(k0, k1, 0, rows);
+            }
             return;
         }
 
-        if (operation == "+") {
-            Set result = Set::unionSets(sets[indexA], sets[indexB]);
-            std::cout << setNameA << " + " << setNameB << " = ";
-            result.print();
-        }
-        else if (operation == "&") {
-            Set result = Set::intersection(sets[indexA], sets[indexB]);
-            std::cout << setNameA << " & " << setNameB << " = ";
-            result.print();
-        }
-        else if (operation == "-") {
-            Set result = Set::difference(sets[indexA], sets[indexB]);
-            std::cout << setNameA << " - " << setNameB << " = ";
-            result.print();
-        }
-        else if (operation == "<") {
-            bool isSubset = Set::isSubset(sets[indexA], sets[indexB]);
-            std::cout << setNameA << " < " << setNameB << " = "
-                << (isSubset ? "true" : "false") << std::endl;
+        Barrier barrier(threads);
+        int chunk = (rows + threads - 1) / threads;
+        auto worker = [&](unsigned t) {
+            int from = std::min(rows, static_cast<int>(t) * chunk);
+            int to = std::min(rows, from + chunk);
+            for (int k0 = 0; k0 < rows; k0 += BLOCK) {
+                int k1 = std::min(rows, k0 + BLOCK);
+                if (t == 0) closePivotBlock(k0, k1);
+                barrier.wait();
+                absorbPivotBlock(k0, k1, from, to);
+                barrier.wait();
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; t++) {
+            workers.emplace_back(worker, t);
         }
-        else if (operation == "=") {
-            bool areEqual = Set::areEqual(sets[indexA], sets[indexB]);
-            std::cout << setNameA << " = " << setNameB << " = "
-                << (areEqual ? "true" : "false") << std::endl;
+        worker(0);
+        for (auto& thread : workers) {
+            thread.join();
         }
     }
 
-    bool setExists(const std::string& name) {
-        return findSetIndex(name) != -1;
-    }
-
-    const std::vector<Set>& getSets() const {
-        return sets;
+    bool isSubsetOf(const BitMatrix& other) const {
+        for (size_t i = 0; i < data.size(); i++) {
+            if (data[i] & ~other.data[i]) return false;
+        }
+        return true;
     }
 };
 
-class CommandProcessor {
+class Relation {
 private:
-    SetManager manager;
+    std::string name;
+    std::vector<char> domain;      //элементы левого множества (строки)
+    std::vector<char> codomain;    //элементы правого множества (столбцы)
+    BitMatrix matrix;
 
-    void printHelp() {
-        std::cout << "\n=== Available Commands ===\n";
-        std::cout << "new A           - Create new set A (A-Z)\n";
-        std::cout << "del A           - Delete set A\n";
-        std::cout << "add A x         - Add element x to set A\n";
-        std::cout << "rem A x         - Remove element x from set A\n";
-        std::cout << "pow A           - Show power set of A\n";
-        std::cout << "see             - Show all sets\n";
-        std::cout << "see A           - Show set A\n";
-        std::cout << "A + B           - Union of sets A and B\n";
-        std::cout << "A & B           - Intersection of sets A and B\n";
-        std::cout << "A - B           - Difference of sets A and B\n";
-        std::cout << "A < B           - Check if A is subset of B\n";
-        std::cout << "A = B           - Check if A equals B\n";
-        std::cout << "demo            - Auto demonstration\n";
-        std::cout << "help            - Show this help\n";
-        std::cout << "exit            - Exit program\n";
-        std::cout << "==========================\n\n";
+    void checkName(const std::string& n) {
+        if (n.length() != 1 || n[0] < 'a' || n[0] > 'z') {
+            throw std::invalid_argument("The name of the relation must be a single character in the a-z range");
+        }
     }
 
-    void autoDemo() {
-        std::cout << "=== Automatic Demonstration ===" << std::endl;
-
-        SetManager manager;
-
-        //создание
-        manager.createSet("A");
-        manager.createSet("B");
-        manager.createSet("C");
+    static int position(const std::vector<char>& elements, char element) {
+        auto it = std::lower_bound(elements.begin(), elements.end(), element);
+        if (it == elements.end() || *it != element) return -1;
+        return static_cast<int>(it - elements.begin());
+    }
 
-        //добавление эл
-        manager.addElement("A", 'a');
-        manager.addElement("A", 'c');
-        manager.addElement("A", 'e');
-        manager.addElement("A", 'g');
+    Relation(const std::string& relationName, const std::vector<char>& rowElements, const std::vector<char>& colElements)
+        : domain(rowElements), codomain(colElements),
+        matrix(static_cast<int>(rowElements.size()), static_cast<int>(colElements.size())) {
+        checkName(relationName);
+        name = relationName;
+    }
 
-        manager.addElement("B", 'b');
-        manager.addElement("B", 'c');
-        manager.addElement("B", 'd');
-        manager.addElement("B", 'e');
+    void checkSquare() const {
+        if (domain != codomain) {
+            throw std::invalid_argument("Relation " + name + " must be defined on a single set");
+        }
+    }
 
-        manager.addElement("C", 'a');
-        manager.addElement("C", 'e');
+public:
+    //пустое отношение r ⊆ A×B
+    Relation(const std::string& relationName, const Set& setA, const Set& setB)
+        : Relation(relationName, setA.getElements(), setB.getElements()) {}
 
-        //все множества
-        manager.showSets();
+    std::string getName() const {
+        return name;
+    }
 
-        //операции
-        std::cout << "\n--- Set Operations ---" << std::endl;
+    int getSize() const {
+        int count = 0;
+        for (int i = 0; i < matrix.getRows(); i++) {
+            for (int j = 0; j < matrix.getCols(); j++) {
+                if (matrix.get(i, j)) count++;
+            }
+        }
+        return count;
+    }
+
+    void addPair(char x, char y) {
+        int i = position(domain, x);
+        int j = position(codomain, y);
+        if (i == -1 || j == -1) {
+            throw std::invalid_argument("Pair is outside the domain of relation " + name);
+        }
+        matrix.set(i, j);
+    }
+
+    bool isReflexive() const {
+        checkSquare();
+        for (int i = 0; i < matrix.getRows(); i++) {
+            if (!matrix.get(i, i)) return false;
+        }
+        return true;
+    }
+
+    bool isSymmetric() const {
+        checkSquare();
+        for (int i = 0; i < matrix.getRows(); i++) {
+            for (int j = i + 1; j < matrix.getCols(); j++) {
+                if (matrix.get(i, j) != matrix.get(j, i)) return false;
+            }
+        }
+        return true;
+    }
+
+    //r транзитивно, если r∘r ⊆ r
+    bool isTransitive() const {
+        checkSquare();
+        return BitMatrix::multiply(matrix, matrix).isSubsetOf(matrix);
+    }
+
+    void print(std::ostream& out = std::cout) const {
+        out << name << " = {";
+        bool firstPair = true;
+        for (int i = 0; i < matrix.getRows(); i++) {
+            for (int j = 0; j < matrix.getCols(); j++) {
+                if (!matrix.get(i, j)) continue;
+                if (!firstPair) out << ", ";
+                out << "(" << domain[i] << ", " << codomain[j] << ")";
+                firstPair = false;
+            }
+        }
+        out << "}" << std::endl;
+    }
+
+    //декартово произведение A×B
+    static Relation cartesianProduct(const std::string& relationName, const Set& setA, const Set& setB) {
+        Relation result(relationName, setA, setB);
+        result.matrix.fill();
+        return result;
+    }
+
+    //композиция: (x, z), если x r y и y s z
+    static Relation compose(const std::string& relationName, const Relation& r, const Relation& s) {
+        if (r.codomain != s.domain) {
+            throw std::invalid_argument("Relations " + r.name + " and " + s.name + " cannot be composed");
+        }
+        Relation result(relationName, r.domain, s.codomain);
+        result.matrix = BitMatrix::multiply(r.matrix, s.matrix);
+        return result;
+    }
+
+    static Relation transitiveClosure(const std::string& relationName, const Relation& r) {
+        r.checkSquare();
+        Relation result(relationName, r.domain, r.codomain);
+        result.matrix = r.matrix;
+        result.matrix.transitiveClosure();
+        return result;
+    }
+};
+
+//словарь строковых элементов: каждой строке сопоставлен плотный номер (0, 1, 2, ...);
+//строки хранятся подряд в одном буфере, поиск – открытая адресация по номерам
+class Dictionary {
+private:
+    std::string pool;                //все строки подряд
+    std::vector<uint32_t> offsets;   //offsets[id] – начало строки id в pool, последний – конец pool
+    std::vector<uint32_t> slots;     //id + 1 или 0 для пустой ячейки, размер – степень двойки
+
+    static uint64_t hash(const std::string& word) {
+        uint64_t h = 1469598103934665603ULL;
+        for (char c : word) {
+            h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+        }
+        return h;
+    }
+
+    bool equals(uint32_t id, const std::string& word) const {
+        return offsets[id + 1] - offsets[id] == word.size()
+            && pool.compare(offsets[id], word.size(), word) == 0;
+    }
+
+    //ячейка со строкой word или пустая ячейка, куда её следует поместить
+    size_t findSlot(const std::string& word) const {
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash(word) & mask;; i = (i + 1) & mask) {
+            if (slots[i] == 0 || equals(slots[i] - 1, word)) return i;
+        }
+    }
+
+    //заполненность таблицы не больше половины
+    void reserveSlots(size_t count) {
+        if (count * 2 <= slots.size()) return;
+
+        size_t capacity = slots.size();
+        while (count * 2 > capacity) capacity <<= 1;
+
+        std::vector<uint32_t> old(capacity, 0);
+        old.swap(slots);
+        for (uint32_t entry : old) {
+            if (entry == 0) continue;
+            std::string word = lookup(entry - 1);
+            slots[findSlot(word)] = entry;
+        }
+    }
+
+    uint32_t append(const std::string& word, size_t slot) {
+        uint32_t id = static_cast<uint32_t>(getSize());
+        pool += word;
+        offsets.push_back(static_cast<uint32_t>(pool.size()));
+        slots[slot] = id + 1;
+        return id;
+    }
+
+public:
+    Dictionary() : offsets(1, 0), slots(16, 0) {}
+
+    size_t getSize() const {
+        return offsets.size() - 1;
+    }
+
+    uint32_t intern(const std::string& word) {
+        reserveSlots(getSize() + 1);
+        size_t slot = findSlot(word);
+        if (slots[slot] != 0) return slots[slot] - 1;
+        return append(word, slot);
+    }
+
+    bool find(const std::string& word, uint32_t& id) const {
+        size_t slot = findSlot(word);
+        if (slots[slot] == 0) return false;
+        id = slots[slot] - 1;
+        return true;
+    }
+
+    std::string lookup(uint32_t id) const {
+        return pool.substr(offsets[id], offsets[id + 1] - offsets[id]);
+    }
+
+    //пакетное пополнение: память резервируется один раз, новые строки получают
+    //номера в лексикографическом порядке; возвращает номера слов в исходном порядке
+    std::vector<uint32_t> internAll(const std::vector<std::string>& words) {
+        std::vector<std::string> fresh;
+        uint32_t id = 0;
+        for (const auto& word : words) {
+            if (!find(word, id)) fresh.push_back(word);
+        }
+        std::sort(fresh.begin(), fresh.end());
+        fresh.erase(std::unique(fresh.begin(), fresh.end()), fresh.end());
+
+        size_t length = 0;
+        for (const auto& word : fresh) {
+            length += word.size();
+        }
+        pool.reserve(pool.size() + length);
+        offsets.reserve(offsets.size() + fresh.size());
+        reserveSlots(getSize() + fresh.size());
+
+        for (const auto& word : fresh) {
+            append(word, findSlot(word));
+        }
+
+        std::vector<uint32_t> ids;
+        ids.reserve(words.size());
+        for (const auto& word : words) {
+            find(word, id);
+            ids.push_back(id);
+        }
+        return ids;
+    }
+
+    size_t memoryUsage() const {
+        return sizeof(Dictionary) + pool.capacity()
+            + (offsets.capacity() + slots.capacity()) * sizeof(uint32_t);
+    }
+};
+
+//множество строк: хранит номера из словаря. Редкое множество – отсортированный массив номеров,
+//плотное – битовая карта по номерам; представление выбирается по плотности, поэтому память
+//и время операций зависят от размера множества, а не от наибольшего номера в словаре
+class StringSet {
+private:
+    //бит карты на элемент, при котором карта не больше массива 32-битных номеров
+    static const size_t DENSE_RATIO = 32;
+
+    std::string name;
+    bool dense = false;
+    std::vector<uint32_t> ids;      //редкое представление, по возрастанию
+    std::vector<uint64_t> bits;     //плотное представление
+    size_t count;
+
+    void checkName(const std::string& n) {
+        if (n.length() != 1 || n[0] < 'A' || n[0] > 'Z') {
+            throw std::invalid_argument("The name of the set must be a single character in the A-Z range");
+        }
+    }
+
+    uint64_t word(size_t w) const {
+        return w < bits.size() ? bits[w] : 0;
+    }
+
+    //смена представления с запасом в 2 раза по плотности, чтобы не переключаться на каждом изменении
+    void normalize() {
+        if (!dense) {
+            if (count > 0 && count * DENSE_RATIO >= static_cast<size_t>(ids.back()) + 1) {
+                bits.assign((ids.back() >> 6) + 1, 0);
+                for (uint32_t id : ids) {
+                    bits[id >> 6] |= uint64_t(1) << (id & 63);
+                }
+                std::vector<uint32_t>().swap(ids);
+                dense = true;
+            }
+        }
+        else if (count * DENSE_RATIO * 2 < bits.size() * 64) {
+            ids = getElements();
+            std::vector<uint64_t>().swap(bits);
+            dense = false;
+        }
+    }
+
+    static StringSet fromIds(std::vector<uint32_t> sorted) {
+        StringSet result("T");
+        result.count = sorted.size();
+        result.ids = std::move(sorted);
+        result.normalize();
+        return result;
+    }
+
+    static StringSet fromBits(std::vector<uint64_t> words) {
+        StringSet result("T");
+        result.dense = true;
+        result.bits = std::move(words);
+        for (uint64_t w : result.bits) {
+            result.count += popCount(w);
+        }
+        result.normalize();
+        return result;
+    }
+
+    //поэлементная операция над словами двух карт
+    template <typename Op>
+    static StringSet combine(const StringSet& setA, const StringSet& setB, size_t words, Op op) {
+        std::vector<uint64_t> result(words);
+        for (size_t w = 0; w < words; w++) {
+            result[w] = op(setA.word(w), setB.word(w));
+        }
+        return fromBits(std::move(result));
+    }
+
+    //слияние двух редких множеств ядром SortedKernels; capacity – верхняя граница результата
+    template <typename Kernel>
+    static StringSet merge(const StringSet& setA, const StringSet& setB, size_t capacity, Kernel kernel) {
+        std::vector<uint32_t> result(capacity);
+        result.resize(kernel(setA.ids.data(), setA.ids.size(), setB.ids.data(), setB.ids.size(), result.data()));
+        return fromIds(std::move(result));
+    }
+
+    //элементы редкого множества, для которых keep(id) истинно
+    template <typename Keep>
+    static StringSet filter(const StringSet& sparse, Keep keep) {
+        std::vector<uint32_t> result;
+        for (uint32_t id : sparse.ids) {
+            if (keep(id)) result.push_back(id);
+        }
+        return fromIds(std::move(result));
+    }
+
+    //плотное множество с установленными (set) или снятыми битами номеров редкого
+    static StringSet overlay(const StringSet& denseSet, const StringSet& sparse, bool set) {
+        std::vector<uint64_t> result = denseSet.bits;
+        for (uint32_t id : sparse.ids) {
+            if (set) {
+                if ((id >> 6) >= result.size()) result.resize((id >> 6) + 1, 0);
+                result[id >> 6] |= uint64_t(1) << (id & 63);
+            }
+            else if ((id >> 6) < result.size()) {
+                result[id >> 6] &= ~(uint64_t(1) << (id & 63));
+            }
+        }
+        return fromBits(std::move(result));
+    }
+
+public:
+    StringSet(const std::string& setName) : count(0) {
+        checkName(setName);
+        name = setName;
+    }
+
+    std::string getName() const {
+        return name;
+    }
+
+    size_t getSize() const {
+        return count;
+    }
+
+    bool isDense() const {
+        return dense;
+    }
+
+    size_t memoryUsage() const {
+        return sizeof(StringSet) + ids.capacity() * sizeof(uint32_t) + bits.capacity() * sizeof(uint64_t);
+    }
+
+    bool contains(uint32_t id) const {
+        if (dense) return (word(id >> 6) >> (id & 63)) & 1;
+        return std::binary_search(ids.begin(), ids.end(), id);
+    }
+
+    void addElement(uint32_t id) {
+        if (dense) {
+            if (contains(id)) return;
+            if ((id >> 6) >= bits.size()) {
+                bits.resize((id >> 6) + 1, 0);
+            }
+            bits[id >> 6] |= uint64_t(1) << (id & 63);
+        }
+        else {
+            auto it = std::lower_bound(ids.begin(), ids.end(), id);
+            if (it != ids.end() && *it == id) return;
+            ids.insert(it, id);
+        }
+        count++;
+        normalize();
+    }
+
+    void removeElement(uint32_t id) {
+        if (!contains(id)) return;
+        if (dense) {
+            bits[id >> 6] &= ~(uint64_t(1) << (id & 63));
+        }
+        else {
+            ids.erase(std::lower_bound(ids.begin(), ids.end(), id));
+        }
+        count--;
+        normalize();
+    }
+
+    std::vector<uint32_t> getElements() const {
+        if (!dense) return ids;
+        std::vector<uint32_t> elements;
+        elements.reserve(count);
+        for (size_t w = 0; w < bits.size(); w++) {
+            for (uint64_t rest = bits[w]; rest != 0; rest &= rest - 1) {
+                elements.push_back(static_cast<uint32_t>(w * 64 + lowestBit(rest)));
+            }
+        }
+        return elements;
+    }
+
+    //строки восстанавливаются по словарю только при выводе
+    void print(std::ostream& out, const Dictionary& dictionary) const {
+        out << "$" << name << " = ";
+        printElements(out, dictionary);
+    }
+
+    //только содержимое, без имени: так выводятся безымянные результаты операций
+    void printElements(std::ostream& out, const Dictionary& dictionary) const {
+        out << "{";
+        std::vector<uint32_t> elements = getElements();
+        for (size_t i = 0; i < elements.size(); i++) {
+            out << dictionary.lookup(elements[i]);
+            if (i + 1 < elements.size()) out << ", ";
+        }
+        out << "}" << std::endl;
+    }
+
+    static StringSet unionSets(const StringSet& setA, const StringSet& setB) {
+        if (setA.dense && setB.dense) {
+            return combine(setA, setB, std::max(setA.bits.size(), setB.bits.size()),
+                [](uint64_t a, uint64_t b) { return a | b; });
+        }
+        if (setA.dense) return overlay(setA, setB, true);
+        if (setB.dense) return overlay(setB, setA, true);
+        return merge(setA, setB, setA.count + setB.count, SortedKernels<uint32_t>::unionOf);
+    }
+
+    static StringSet intersection(const StringSet& setA, const StringSet& setB) {
+        if (setA.dense && setB.dense) {
+            return combine(setA, setB, std::min(setA.bits.size(), setB.bits.size()),
+                [](uint64_t a, uint64_t b) { return a & b; });
+        }
+        if (setA.dense) return filter(setB, [&](uint32_t id) { return setA.contains(id); });
+        if (setB.dense) return filter(setA, [&](uint32_t id) { return setB.contains(id); });
+        return merge(setA, setB, std::min(setA.count, setB.count), SortedKernels<uint32_t>::intersection);
+    }
+
+    static StringSet difference(const StringSet& setA, const StringSet& setB) {
+        if (setA.dense && setB.dense) {
+            return combine(setA, setB, setA.bits.size(),
+                [](uint64_t a, uint64_t b) { return a & ~b; });
+        }
+        if (setA.dense) return overlay(setA, setB, false);
+        if (setB.dense) return filter(setA, [&](uint32_t id) { return !setB.contains(id); });
+        return merge(setA, setB, setA.count, SortedKernels<uint32_t>::difference);
+    }
+
+    static bool isSubset(const StringSet& setA, const StringSet& setB) {
+        if (setA.count > setB.count) return false;
+        if (setA.dense && setB.dense) {
+            for (size_t w = 0; w < setA.bits.size(); w++) {
+                if (setA.bits[w] & ~setB.word(w)) return false;
+            }
+            return true;
+        }
+        if (!setA.dense && !setB.dense) {
+            return std::includes(setB.ids.begin(), setB.ids.end(), setA.ids.begin(), setA.ids.end());
+        }
+        for (uint32_t id : setA.getElements()) {
+            if (!setB.contains(id)) return false;
+        }
+        return true;
+    }
+
+    static bool areEqual(const StringSet& setA, const StringSet& setB) {
+        return setA.count == setB.count && isSubset(setA, setB);
+    }
+};
+
+//множества A-Z в разделяемой памяти POSIX для нескольких процессов одного узла.
+//Раскладка без указателей: заголовок хранит смещения двух каталогов от начала сегмента,
+//каталог – версию, маску существующих множеств и их битовые карты. Единственный писатель
+//заполняет неопубликованный каталог и атомарно переключает на него заголовок; читатели
+//отображают сегмент только для чтения и копируют каталог под счётчиком последовательности
+//(seqlock) без блокировок, повторяя чтение, если писатель успел его переписать
+class SharedSetSegment {
+public:
+    static const int SLOTS = 26;
+    static const int CATALOGS = 2;
+    static const uint64_t MAGIC = 0x3253544553534944ULL;   //"DISSETS2"
+
+    //копия опубликованного состояния
+    struct Catalog {
+        uint64_t version = 0;
+        uint64_t present = 0;       //бит s – множество 'A' + s существует
+        Set::Bitmap sets[SLOTS];
+    };
+
+private:
+    static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+        "Shared segment needs address-free atomics");
+
+    struct SharedCatalog {
+        std::atomic<uint64_t> sequence;     //нечётное – идёт запись
+        std::atomic<uint64_t> version;
+        std::atomic<uint64_t> present;
+        std::atomic<uint64_t> words[SLOTS][Set::Bitmap::WORDS];
+    };
+
+    struct SharedHeader {
+        std::atomic<uint64_t> magic;        //записывается последним: сегмент готов
+        uint64_t size;
+        int64_t writerPid;                  //процесс-писатель: по нему находят брошенный сегмент
+        uint64_t catalogOffset[CATALOGS];
+        std::atomic<uint32_t> published;    //номер последнего опубликованного каталога
+    };
+
+    static const size_t SEGMENT_SIZE = sizeof(SharedHeader) + CATALOGS * sizeof(SharedCatalog);
+
+    std::string name;
+    void* base = nullptr;
+    bool writer = false;
+    bool reclaimed = false;
+
+    SharedHeader* header() const {
+        return static_cast<SharedHeader*>(base);
+    }
+
+    SharedCatalog& catalogAt(uint32_t index) const {
+        return *reinterpret_cast<SharedCatalog*>(static_cast<char*>(base) + header()->catalogOffset[index]);
+    }
+
+#ifdef SETS_SHARED_MEMORY
+    //имя занято: если записавший сегмент процесс завершился, не удалив его (аварийно), имя
+    //освобождается; если он жив или сегмент чужой, это ошибка. Вручную брошенный сегмент
+    //удаляется через shm_unlink или, в Linux, rm /dev/shm/<name>
+    static bool reclaimStale(const std::string& segmentName) {
+        int fd = shm_open(segmentName.c_str(), O_RDONLY, 0);
+        if (fd == -1) return false;   //имя уже освободили
+        struct stat info;
+        bool sized = fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(SharedHeader);
+        void* mapped = sized ? mmap(nullptr, sizeof(SharedHeader), PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            throw std::runtime_error("Shared segment " + segmentName + " already exists and is not a set segment;"
+                " remove it by hand if it is stale");
+        }
+        const SharedHeader* existing = static_cast<const SharedHeader*>(mapped);
+        bool known = existing->magic.load(std::memory_order_acquire) == MAGIC;
+        pid_t pid = static_cast<pid_t>(existing->writerPid);
+        munmap(mapped, sizeof(SharedHeader));
+
+        if (!known) {
+            throw std::runtime_error("Shared segment " + segmentName + " already exists and has an unknown layout;"
+                " remove it by hand if it is stale");
+        }
+        if (pid > 0 && (kill(pid, 0) == 0 || errno == EPERM)) {
+            throw std::runtime_error("Shared segment " + segmentName + " is in use by writer pid " + std::to_string(pid));
+        }
+        return shm_unlink(segmentName.c_str()) == 0;
+    }
+#endif
+
+    SharedSetSegment(const std::string& segmentName, bool isWriter) : name("/" + segmentName), writer(isWriter) {
+#ifdef SETS_SHARED_MEMORY
+        int fd = -1;
+        if (isWriter) {
+            fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+            if (fd == -1 && errno == EEXIST) {
+                reclaimed = reclaimStale(name);
+                fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+            }
+        }
+        else {
+            fd = shm_open(name.c_str(), O_RDONLY, 0);
+        }
+        if (fd == -1) {
+            throw std::runtime_error((isWriter ? "Cannot create shared segment " : "Cannot open shared segment ")
+                + name + ": " + std::strerror(errno));
+        }
+
+        bool sized = false;
+        if (isWriter) {
+            sized = ftruncate(fd, SEGMENT_SIZE) == 0;
+        }
+        else {
+            struct stat info;
+            sized = fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= SEGMENT_SIZE;
+        }
+        if (!sized) {
+            close(fd);
+            if (isWriter) shm_unlink(name.c_str());
+            throw std::runtime_error("Shared segment " + name + " has wrong size");
+        }
+        void* mapped = mmap(nullptr, SEGMENT_SIZE, isWriter ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            if (isWriter) shm_unlink(name.c_str());
+            throw std::runtime_error("Cannot map shared segment " + name);
+        }
+        base = mapped;
+
+        if (isWriter) {
+            //новый сегмент заполнен нулями; смещения задаются до публикации magic
+            header()->size = SEGMENT_SIZE;
+            header()->writerPid = static_cast<int64_t>(getpid());
+            for (int c = 0; c < CATALOGS; c++) {
+                header()->catalogOffset[c] = sizeof(SharedHeader) + c * sizeof(SharedCatalog);
+            }
+            header()->magic.store(MAGIC, std::memory_order_release);
+        }
+        else if (header()->magic.load(std::memory_order_acquire) != MAGIC || header()->size != SEGMENT_SIZE) {
+            munmap(base, SEGMENT_SIZE);
+            base = nullptr;
+            throw std::runtime_error("Shared segment " + name + " has an unknown layout");
+        }
+#else
+        throw std::runtime_error("Shared memory is not supported on this platform");
+#endif
+    }
+
+public:
+    //сегмент создаёт единственный писатель; сегмент с тем же именем – ошибка, если только
+    //его писатель не завершился, не удалив имя (тогда имя освобождается, см. reclaimStale)
+    static std::unique_ptr<SharedSetSegment> create(const std::string& segmentName) {
+        return std::unique_ptr<SharedSetSegment>(new SharedSetSegment(segmentName, true));
+    }
+
+    static std::unique_ptr<SharedSetSegment> open(const std::string& segmentName) {
+        return std::unique_ptr<SharedSetSegment>(new SharedSetSegment(segmentName, false));
+    }
+
+    SharedSetSegment(const SharedSetSegment&) = delete;
+    SharedSetSegment& operator=(const SharedSetSegment&) = delete;
+
+    //писатель удаляет имя сегмента; уже подключённые читатели сохраняют отображение
+    ~SharedSetSegment() {
+#ifdef SETS_SHARED_MEMORY
+        if (base != nullptr) munmap(base, SEGMENT_SIZE);
+        if (writer) shm_unlink(name.c_str());
+#endif
+    }
+
+    const std::string& getName() const {
+        return name;
+    }
+
+    bool isWriter() const {
+        return writer;
+    }
+
+    //писатель занял имя, брошенное завершившимся процессом
+    bool wasReclaimed() const {
+        return reclaimed;
+    }
+
+    void publish(const SetHistory::Snapshot& snapshot) {
+        if (!writer) {
+            throw std::logic_error("Only the writer can publish to " + name);
+        }
+        uint32_t next = 1 - header()->published.load(std::memory_order_relaxed);
+        SharedCatalog& target = catalogAt(next);
+
+        uint64_t sequence = target.sequence.load(std::memory_order_relaxed);
+        target.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        uint64_t present = 0;
+        for (int s = 0; s < SLOTS; s++) {
+            const Set::Bitmap* bits = snapshot->sets[s].get();
+            if (bits != nullptr) present |= uint64_t(1) << s;
+            for (int w = 0; w < Set::Bitmap::WORDS; w++) {
+                target.words[s][w].store(bits != nullptr ? bits->word(w) : 0, std::memory_order_relaxed);
+            }
+        }
+        target.version.store(snapshot->version, std::memory_order_relaxed);
+        target.present.store(present, std::memory_order_relaxed);
+
+        target.sequence.store(sequence + 2, std::memory_order_release);
+        header()->published.store(next, std::memory_order_release);
+    }
+
+    Catalog read() const {
+        Catalog result;
+        while (true) {
+            const SharedCatalog& source = catalogAt(header()->published.load(std::memory_order_acquire));
+            uint64_t before = source.sequence.load(std::memory_order_acquire);
+            if (before & 1) continue;
+
+            result.version = source.version.load(std::memory_order_relaxed);
+            result.present = source.present.load(std::memory_order_relaxed);
+            for (int s = 0; s < SLOTS; s++) {
+                uint64_t words[Set::Bitmap::WORDS];
+                for (int w = 0; w < Set::Bitmap::WORDS; w++) {
+                    words[w] = source.words[s][w].load(std::memory_order_relaxed);
+                }
+                result.sets[s] = Set::Bitmap::fromWords(words);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (source.sequence.load(std::memory_order_relaxed) == before) return result;
+        }
+    }
+};
+
+//ограниченный кэш результатов операций над множествами: ключ – операция и версии
+//обоих множеств, при переполнении вытесняется давно не использованная запись
+class ResultCache {
+public:
+    struct Key {
+        char operation;
+        uint64_t versionA;
+        uint64_t versionB;
+
+        bool operator==(const Key& other) const {
+            return operation == other.operation && versionA == other.versionA && versionB == other.versionB;
+        }
+    };
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            uint64_t h = key.versionA * 0x9E3779B97F4A7C15ULL;
+            h ^= key.versionB + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+            return static_cast<size_t>(h ^ static_cast<unsigned char>(key.operation));
+        }
+    };
+
+    typedef std::list<std::pair<Key, std::string>> Entries;
+
+    size_t capacity;
+    Entries entries;   //в начале – последние использованные
+    std::unordered_map<Key, Entries::iterator, KeyHash> lookup;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+public:
+    explicit ResultCache(size_t maxEntries) : capacity(maxEntries) {}
+
+    bool get(const Key& key, std::string& value) {
+        auto it = lookup.find(key);
+        if (it == lookup.end()) {
+            misses++;
+            return false;
+        }
+        hits++;
+        entries.splice(entries.begin(), entries, it->second);
+        value = it->second->second;
+        return true;
+    }
+
+    void put(const Key& key, const std::string& value) {
+        auto it = lookup.find(key);
+        if (it != lookup.end()) {
+            it->second->second = value;
+            entries.splice(entries.begin(), entries, it->second);
+            return;
+        }
+
+        entries.emplace_front(key, value);
+        lookup[key] = entries.begin();
+        if (entries.size() > capacity) {
+            lookup.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+
+    uint64_t getHits() const {
+        return hits;
+    }
+
+    uint64_t getMisses() const {
+        return misses;
+    }
+
+    size_t getSize() const {
+        return entries.size();
+    }
+
+    size_t getCapacity() const {
+        return capacity;
+    }
+};
+
+class SetManager {
+private:
+    SetStore store;
+    std::vector<Relation> relations;
+    std::vector<StringSet> stringSets;
+    Dictionary dictionary;
+    std::vector<std::pair<std::string, DiskSet>> diskSets;
+    std::string diskDirectory = std::filesystem::temp_directory_path().string();
+    std::mt19937_64 rng{ std::random_device{}() };
+    std::ostream* out = &std::cout;
+    //повторные операции над неизменившимися множествами берутся из кэша
+    ResultCache cache{ 256 };
+    //сегмент разделяемой памяти: свой (писатель) или чужой (читатель)
+    std::unique_ptr<SharedSetSegment> shared;
+
+    const std::vector<Set>& sets() const {
+        return store.getSets();
+    }
+
+    int findSetIndex(const std::string& name) {
+        TraceSpan span("findSetIndex");
+        return name.size() == 1 ? store.indexOf(name[0]) : -1;
+    }
+
+    //отсутствие множества или версии командный интерфейс сообщает своим текстом,
+    //остальные ошибки встраиваемого API – так же, как ошибки разбора
+    static void check(SetStatus status) {
+        if (status != SET_OK && status != SET_NOT_FOUND && status != SET_ALREADY_EXISTS
+            && status != SET_VERSION_NOT_AVAILABLE) {
+            throw std::invalid_argument(statusMessage(status));
+        }
+    }
+
+    static char key(const std::string& name) {
+        return name.size() == 1 ? name[0] : '\0';
+    }
+
+    //результат операции над битовыми картами: множество T или true/false
+    static void printResult(std::ostream& text, char operation, const Set::Bitmap& bitsA, const Set::Bitmap& bitsB) {
+        if (SetStore::isTest(operation)) {
+            SetResult<bool> answer = SetStore::test(operation, bitsA, bitsB);
+            check(answer.status);
+            text << (answer.value ? "true" : "false") << std::endl;
+        }
+        else {
+            SetResult<Set::Bitmap> result = SetStore::apply(operation, bitsA, bitsB);
+            check(result.status);
+            printBits(text, "T", result.value);
+        }
+    }
+
+    //писатель публикует каждую новую версию
+    void publishShared() {
+        if (shared != nullptr && shared->isWriter()) {
+            shared->publish(store.getHistory().getHead());
+        }
+    }
+
+    int findStringSetIndex(const std::string& name) {
+        for (size_t i = 0; i < stringSets.size(); i++) {
+            if (stringSets[i].getName() == name) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    int findDiskSetIndex(const std::string& name) {
+        for (size_t i = 0; i < diskSets.size(); i++) {
+            if (diskSets[i].first == name) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    int findRelationIndex(const std::string& name) {
+        for (size_t i = 0; i < relations.size(); i++) {
+            if (relations[i].getName() == name) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    void storeRelation(const Relation& relation) {
+        int index = findRelationIndex(relation.getName());
+        if (index == -1) {
+            relations.push_back(relation);
+        }
+        else {
+            relations[index] = relation;
+        }
+    }
+
+public:
+    void setOutput(std::ostream& stream) {
+        out = &stream;
+    }
+
+    void createSet(const std::string& name) {
+        SetStatus status = store.createSet(key(name));
+        check(status);
+        if (status == SET_ALREADY_EXISTS) {
+            *out << "Set " << name << " already exists!" << std::endl;
+            return;
+        }
+        publishShared();
+        *out << "Set " << name << " created successfully." << std::endl;
+    }
+
+    void deleteSet(const std::string& name) {
+        SetStatus status = store.deleteSet(key(name));
+        check(status);
+        if (status == SET_NOT_FOUND) {
+            *out << "Set " << name << " not found!" << std::endl;
+            return;
+        }
+        publishShared();
+        *out << "Set " << name << " deleted successfully." << std::endl;
+    }
+
+    void addElement(const std::string& setName, char element) {
+        SetStatus status = store.addElement(key(setName), element);
+        check(status);
+        if (status == SET_NOT_FOUND) {
+            *out << "Set " << setName << " not found!" << std::endl;
+            return;
+        }
+        publishShared();
+        *out << "Element '" << element << "' added to set " << setName << std::endl;
+    }
+
+    void removeElement(const std::string& setName, char element) {
+        SetStatus status = store.removeElement(key(setName), element);
+        check(status);
+        if (status == SET_NOT_FOUND) {
+            *out << "Set " << setName << " not found!" << std::endl;
+            return;
+        }
+        publishShared();
+        *out << "Element '" << element << "' removed from set " << setName << std::endl;
+    }
+
+    void showPowerSet(const std::string& setName) {
+        int index = findSetIndex(setName);
+        if (index == -1) {
+            *out << "Set " << setName << " not found!" << std::endl;
+            return;
+        }
+
+        std::vector<Set> power = sets()[index].powerSet();
+        *out << "Power set of " << setName << " (size: " << power.size() << "):" << std::endl;
+        for (size_t i = 0; i < power.size(); i++) {
+            *out << "  " << i + 1 << ". ";
+            power[i].print(*out);
+        }
+    }
+
+    void showSubsets(const std::string& setName, int k) {
+        int index = findSetIndex(setName);
+        if (index == -1) {
+            *out << "Set " << setName << " not found!" << std::endl;
+            return;
+        }
+
+        std::vector<Set> subsets = sets()[index].kSubsets(k);
+        *out << "Subsets of " << setName << " with " << k << " elements (count: " << subsets.size() << "):" << std::endl;
+        for (size_t i = 0; i < subsets.size(); i++) {
+            *out << "  " << i + 1 << ". ";
+            subsets[i].print(*out);
+        }
+    }
+
+    void showPowerSetSlice(const std::string& setName, uint64_t from, uint64_t to) {
+        int index = findSetIndex(setName);
+        if (index == -1) {
+            *out << "Set " << setName << " not found!" << std::endl;
+            return;
+        }
+
+        if (from == to) {
+            Set subset = sets()[index].subsetAt(from);
+            *out << "pow " << setName << " #" << from << " = ";
+            subset.print(*out);
+            return;
+        }
+
+        //диапазон длиннее предела превращается в count = предел + 1 и отвергается
+        uint64_t count = to >= from ? std::min(to - from, Set::MAX_LISTED_SUBSETS) + 1 : 0;
+        std::vector<Set> subsets = sets()[index].powerSetSlice(from, count);
+        *out << "Power set of " << setName << " #" << from << ".." << to << ":" << std::endl;
+        for (size_t i = 0; i < subsets.size(); i++) {
+            *out << "  #" << from + i << ". ";
+            subsets[i].print(*out);
+        }
+    }
+
+    void showSubsetIndex(const std::string& setName, const std::string& subsetName) {
+        int index = findSetIndex(setName);
+        int subsetIndex = findSetIndex(subsetName);
+
+        if (index == -1 || subsetIndex == -1) {
+            *out << "One or both sets not found!" << std::endl;
+            return;
+        }
+
+        uint64_t position = sets()[index].subsetIndex(sets()[subsetIndex]);
+        *out << "pow " << setName << " rank " << subsetName << " = #" << position << std::endl;
+    }
+
+    void showRandomSubsets(const std::string& setName, int count) {
+        int index = findSetIndex(setName);
+        if (index == -1) {
+            *out << "Set " << setName << " not found!" << std::endl;
+            return;
+        }
+
+        std::vector<Set> subsets = sets()[index].randomSubsets(count, rng);
+        *out << "Random subsets of " << setName << " (count: " << subsets.size() << "):" << std::endl;
+        for (size_t i = 0; i < subsets.size(); i++) {
+            *out << "  " << i + 1 << ". ";
+            subsets[i].print(*out);
+        }
+    }
+
+    void showRange(const std::string& setName, char lo, char hi) {
+        int index = findSetIndex(setName);
+        if (index == -1) {
+            *out << "Set " << setName << " not found!" << std::endl;
+            return;
+        }
+
+        std::vector<char> elements = sets()[index].getRange(lo, hi);
+        *out << setName << " [" << lo << ".." << hi << "] = {";
+        for (size_t i = 0; i < elements.size(); i++) {
+            *out << elements[i];
+            if (i + 1 < elements.size()) *out << ", ";
+        }
+        *out << "}" << std::endl;
+    }
+
+    void showRank(const std::string& setName, char element) {
+        int index = findSetIndex(setName);
+        if (index == -1) {
+            *out << "Set " << setName << " not found!" << std::endl;
+            return;
+        }
+        *out << "rank " << setName << " " << element << " = " << sets()[index].rank(element) << std::endl;
+    }
+
+    void showMembership(const std::string& setName, const std::string& elements) {
+        int index = findSetIndex(setName);
+        if (index == -1) {
+            *out << "Set " << setName << " not found!" << std::endl;
+            return;
+        }
+        std::vector<uint64_t> mask = sets()[index].containsBatch(elements);
+        std::string result(elements.size(), '0');
+        for (size_t i = 0; i < elements.size(); i++) {
+            if ((mask[i >> 6] >> (i & 63)) & 1) result[i] = '1';
+        }
+        *out << "has " << setName << " " << elements << " = " << result << std::endl;
+    }
+
+    void showSelect(const std::string& setName, int k) {
+        int index = findSetIndex(setName);
+        if (index == -1) {
+            *out << "Set " << setName << " not found!" << std::endl;
+            return;
+        }
+        char element = sets()[index].select(k);
+        *out << "select " << setName << " " << k << " = " << element << std::endl;
+    }
+
+    void showMemory(const std::string& setName = "") {
+        std::vector<const Set*> selected;
+        if (setName.empty()) {
+            for (const auto& set : sets()) {
+                selected.push_back(&set);
+            }
+        }
+        else {
+            int index = findSetIndex(setName);
+            if (index == -1) {
+                *out << "Set " << setName << " not found!" << std::endl;
+                return;
+            }
+            selected.push_back(&sets()[index]);
+        }
+
+        *out << "Memory usage (bytes):" << std::endl;
+        for (const Set* set : selected) {
+            std::vector<uint32_t> values;
+            for (char element : set->getElements()) {
+                values.push_back(static_cast<unsigned char>(element));
+            }
+            *out << "  " << set->getName() << ": " << set->getSize() << " elements, list " << set->memoryUsage()
+                << ", varint " << VarintSet::encode(values).memoryUsage()
+                << ", elias-fano " << EliasFanoSet::encode(values).memoryUsage() << std::endl;
+        }
+    }
+
+    void showSets(const std::string& setName = "") {
+        if (setName.empty()) {
+            if (sets().empty() && stringSets.empty()) {
+                *out << "No sets available." << std::endl;
+                return;
+            }
+            *out << "All sets (" << sets().size() + stringSets.size() << "):" << std::endl;
+            for (const auto& set : sets()) {
+                set.print(*out);
+            }
+            for (const auto& set : stringSets) {
+                set.print(*out, dictionary);
+            }
+        }
+        else {
+            int index = findSetIndex(setName);
+            if (index == -1) {
+                *out << "Set " << setName << " not found!" << std::endl;
+                return;
+            }
+            sets()[index].print(*out);
+        }
+    }
+
+    void performOperation(const std::string& operation, const std::string& setNameA, const std::string& setNameB) {
+        int indexA = findSetIndex(setNameA);
+        int indexB = findSetIndex(setNameB);
+
+        if (indexA == -1 || indexB == -1) {
+            *out << "One or both sets not found!" << std::endl;
+            return;
+        }
+
+        ResultCache::Key cacheKey{ operation[0], sets()[indexA].getVersion(), sets()[indexB].getVersion() };
+        std::string result;
+
+        if (!cache.get(cacheKey, result)) {
+            TraceSpan span("operation");
+            std::ostringstream text;
+            const Set& setA = sets()[indexA];
+            const Set& setB = sets()[indexB];
+            //результат выводится прямо из ленивого представления, без построения множества
+            switch (operation[0]) {
+            case '+': printView(text, "T", unionView(setA, setB)); break;
+            case '&': printView(text, "T", intersectView(setA, setB)); break;
+            case '-': printView(text, "T", differenceView(setA, setB)); break;
+            default: printResult(text, operation[0], setA.getBits(), setB.getBits()); break;
+            }
+            result = text.str();
+            cache.put(cacheKey, result);
+        }
+
+        *out << setNameA << " " << operation << " " << setNameB << " = " << result;
+    }
+
+    void takeSnapshot() {
+        *out << "Snapshot @v" << store.snapshot().value << " taken" << std::endl;
+    }
+
+    void dropSnapshot(uint64_t version) {
+        if (store.release(version) != SET_OK) {
+            *out << "Snapshot @v" << version << " not found!" << std::endl;
+            return;
+        }
+        *out << "Snapshot @v" << version << " dropped" << std::endl;
+    }
+
+    void showSnapshots() {
+        const SetHistory& history = store.getHistory();
+        *out << "Current version: @v" << history.getVersion() << ", live versions: " << history.getLiveVersions() << std::endl;
+        *out << "Snapshots:";
+        for (const auto& snapshot : history.getPinned()) {
+            *out << " @v" << snapshot.first;
+        }
+        *out << std::endl;
+    }
+
+    //состояние множеств в версии version; снимок удерживается на время запроса
+    void showSetsAt(const std::string& setName, uint64_t version) {
+        SetHistory::Snapshot snapshot = store.getHistory().find(version);
+        if (snapshot == nullptr) {
+            *out << "Version @v" << version << " is not available!" << std::endl;
+            return;
+        }
+
+        std::string suffix = " @v" + std::to_string(version);
+        for (int s = 0; s < SetHistory::SLOTS; s++) {
+            std::string name(1, static_cast<char>('A' + s));
+            if (!setName.empty() && setName != name) continue;
+            if (snapshot->sets[s] == nullptr) {
+                if (!setName.empty()) *out << "Set " << setName << " not found in @v" << version << "!" << std::endl;
+                continue;
+            }
+            printBits(*out, name + suffix, *snapshot->sets[s]);
+        }
+    }
+
+    void performOperationAt(const std::string& operation, const std::string& setNameA, const std::string& setNameB,
+        uint64_t version) {
+        char op = operation[0];
+        bool isTest = op == '<' || op == '=';
+        SetResult<Set::Bitmap> combined;
+        SetResult<bool> compared;
+        SetStatus status = isTest ? (compared = store.compareAt(op, key(setNameA), key(setNameB), version)).status
+            : (combined = store.combineAt(op, key(setNameA), key(setNameB), version)).status;
+        check(status);
+
+        if (status == SET_VERSION_NOT_AVAILABLE) {
+            *out << "Version @v" << version << " is not available!" << std::endl;
+            return;
+        }
+        if (status == SET_NOT_FOUND) {
+            *out << "One or both sets not found in @v" << version << "!" << std::endl;
+            return;
+        }
+
+        *out << setNameA << " " << operation << " " << setNameB << " @v" << version << " = ";
+        if (isTest) {
+            *out << (compared.value ? "true" : "false") << std::endl;
+        }
+        else {
+            printBits(*out, "T", combined.value);
+        }
+    }
+
+    void share(const std::string& segmentName, bool writer) {
+        if (shared != nullptr) {
+            *out << "Already attached to " << shared->getName() << "!" << std::endl;
+            return;
+        }
+        if (writer) {
+            shared = SharedSetSegment::create(segmentName);
+            if (shared->wasReclaimed()) {
+                *out << "Removed stale shared segment " << shared->getName() << " left by a writer that exited" << std::endl;
+            }
+            publishShared();
+            *out << "Sharing sets in " << shared->getName() << " (@v" << store.getHistory().getVersion() << ")" << std::endl;
+        }
+        else {
+            shared = SharedSetSegment::open(segmentName);
+            *out << "Attached to " << shared->getName() << " (@v" << shared->read().version << ")" << std::endl;
+        }
+    }
+
+    void detach() {
+        if (shared == nullptr) {
+            *out << "No shared segment attached!" << std::endl;
+            return;
+        }
+        std::string segmentName = shared->getName();
+        shared.reset();
+        *out << "Detached from " << segmentName << std::endl;
+    }
+
+    void showSharedSets(const std::string& setName) {
+        if (shared == nullptr) {
+            *out << "No shared segment attached!" << std::endl;
+            return;
+        }
+        SharedSetSegment::Catalog catalog = shared->read();
+        if (setName.empty()) {
+            *out << "Shared sets in " << shared->getName() << " (@v" << catalog.version << "):" << std::endl;
+        }
+        for (int s = 0; s < SharedSetSegment::SLOTS; s++) {
+            std::string name(1, static_cast<char>('A' + s));
+            if (!setName.empty() && setName != name) continue;
+            if (((catalog.present >> s) & 1) == 0) {
+                if (!setName.empty()) *out << "Set *" << setName << " not found!" << std::endl;
+                continue;
+            }
+            printBits(*out, "*" + name, catalog.sets[s]);
+        }
+    }
+
+    void performSharedOperation(const std::string& operation, const std::string& setNameA, const std::string& setNameB) {
+        if (shared == nullptr) {
+            *out << "No shared segment attached!" << std::endl;
+            return;
+        }
+        SharedSetSegment::Catalog catalog = shared->read();
+        int slotA = setNameA[0] - 'A';
+        int slotB = setNameB[0] - 'A';
+        if (((catalog.present >> slotA) & 1) == 0 || ((catalog.present >> slotB) & 1) == 0) {
+            *out << "One or both sets not found!" << std::endl;
+            return;
+        }
+
+        const Set::Bitmap& bitsA = catalog.sets[slotA];
+        const Set::Bitmap& bitsB = catalog.sets[slotB];
+        *out << "*" << setNameA << " " << operation << " *" << setNameB << " @v" << catalog.version << " = ";
+        printResult(*out, operation[0], bitsA, bitsB);
+    }
+
+    void showCacheStatistics() {
+        *out << "Cache: " << cache.getHits() << " hits, " << cache.getMisses() << " misses, "
+            << cache.getSize() << "/" << cache.getCapacity() << " entries" << std::endl;
+    }
+
+    void createStringSet(const std::string& name) {
+        if (findStringSetIndex(name) != -1) {
+            *out << "Set $" << name << " already exists!" << std::endl;
+            return;
+        }
+        stringSets.push_back(StringSet(name));
+        *out << "Set $" << name << " created successfully." << std::endl;
+    }
+
+    void deleteStringSet(const std::string& name) {
+        int index = findStringSetIndex(name);
+        if (index == -1) {
+            *out << "Set $" << name << " not found!" << std::endl;
+            return;
+        }
+        stringSets.erase(stringSets.begin() + index);
+        *out << "Set $" << name << " deleted successfully." << std::endl;
+    }
+
+    void addStrings(const std::string& setName, const std::vector<std::string>& words) {
+        int index = findStringSetIndex(setName);
+        if (index == -1) {
+            *out << "Set $" << setName << " not found!" << std::endl;
+            return;
+        }
+
+        for (uint32_t id : dictionary.internAll(words)) {
+            stringSets[index].addElement(id);
+        }
+        *out << words.size() << " element(s) added to set $" << setName << std::endl;
+    }
+
+    void removeString(const std::string& setName, const std::string& word) {
+        int index = findStringSetIndex(setName);
+        if (index == -1) {
+            *out << "Set $" << setName << " not found!" << std::endl;
+            return;
+        }
+
+        uint32_t id = 0;
+        if (dictionary.find(word, id)) {
+            stringSets[index].removeElement(id);
+        }
+        *out << "Element '" << word << "' removed from set $" << setName << std::endl;
+    }
+
+    void showStringSet(const std::string& setName) {
+        int index = findStringSetIndex(setName);
+        if (index == -1) {
+            *out << "Set $" << setName << " not found!" << std::endl;
+            return;
+        }
+        stringSets[index].print(*out, dictionary);
+    }
+
+    void performStringOperation(const std::string& operation, const std::string& setNameA, const std::string& setNameB) {
+        int indexA = findStringSetIndex(setNameA);
+        int indexB = findStringSetIndex(setNameB);
+
+        if (indexA == -1 || indexB == -1) {
+            *out << "One or both sets not found!" << std::endl;
+            return;
+        }
+
+        const StringSet& setA = stringSets[indexA];
+        const StringSet& setB = stringSets[indexB];
+        *out << "$" << setNameA << " " << operation << " $" << setNameB << " = ";
+
+        if (operation == "+") {
+            StringSet::unionSets(setA, setB).printElements(*out, dictionary);
+        }
+        else if (operation == "&") {
+            StringSet::intersection(setA, setB).printElements(*out, dictionary);
+        }
+        else if (operation == "-") {
+            StringSet::difference(setA, setB).printElements(*out, dictionary);
+        }
+        else if (operation == "<") {
+            *out << (StringSet::isSubset(setA, setB) ? "true" : "false") << std::endl;
+        }
+        else if (operation == "=") {
+            *out << (StringSet::areEqual(setA, setB) ? "true" : "false") << std::endl;
+        }
+    }
+
+    void setDiskDirectory(const std::string& path) {
+        diskDirectory = path;
+    }
+
+    void createDiskSet(const std::string& name) {
+        if (findDiskSetIndex(name) != -1) {
+            *out << "Set %" << name << " already exists!" << std::endl;
+            return;
+        }
+        diskSets.emplace_back(name, DiskSet(diskDirectory));
+        *out << "Set %" << name << " created successfully." << std::endl;
+    }
+
+    void deleteDiskSet(const std::string& name) {
+        int index = findDiskSetIndex(name);
+        if (index == -1) {
+            *out << "Set %" << name << " not found!" << std::endl;
+            return;
+        }
+        diskSets.erase(diskSets.begin() + index);
+        *out << "Set %" << name << " deleted successfully." << std::endl;
+    }
+
+    //значения из [lo, hi] с шагом step
+    void addDiskRange(const std::string& setName, uint32_t lo, uint32_t hi, uint32_t step) {
+        int index = findDiskSetIndex(setName);
+        if (index == -1) {
+            *out << "Set %" << setName << " not found!" << std::endl;
+            return;
+        }
+
+        uint64_t count = 0;
+        for (uint64_t value = lo; value <= hi; value += step, count++) {
+            diskSets[index].second.addElement(static_cast<uint32_t>(value));
+        }
+        *out << count << " element(s) added to set %" << setName << std::endl;
+    }
+
+    void addDiskElements(const std::string& setName, const std::vector<uint32_t>& values) {
+        int index = findDiskSetIndex(setName);
+        if (index == -1) {
+            *out << "Set %" << setName << " not found!" << std::endl;
+            return;
+        }
+
+        for (uint32_t value : values) {
+            diskSets[index].second.addElement(value);
+        }
+        *out << values.size() << " element(s) added to set %" << setName << std::endl;
+    }
+
+    void showDiskSet(const std::string& setName) {
+        int index = findDiskSetIndex(setName);
+        if (index == -1) {
+            *out << "Set %" << setName << " not found!" << std::endl;
+            return;
+        }
+        diskSets[index].second.print(*out, "%" + setName);
+    }
+
+    //resultName пустое – результат только выводится, иначе сохраняется под этим именем
+    void performDiskOperation(const std::string& operation, const std::string& setNameA, const std::string& setNameB,
+        const std::string& resultName = "") {
+        int indexA = findDiskSetIndex(setNameA);
+        int indexB = findDiskSetIndex(setNameB);
+
+        if (indexA == -1 || indexB == -1) {
+            *out << "One or both sets not found!" << std::endl;
+            return;
+        }
+
+        const DiskSet& setA = diskSets[indexA].second;
+        const DiskSet& setB = diskSets[indexB].second;
+
+        if (operation == "<" || operation == "=") {
+            bool answer = operation == "<" ? DiskSet::isSubset(setA, setB) : DiskSet::areEqual(setA, setB);
+            *out << "%" << setNameA << " " << operation << " %" << setNameB << " = "
+                << (answer ? "true" : "false") << std::endl;
+            return;
+        }
+
+        DiskSet result = operation == "+" ? DiskSet::unionSets(setA, setB)
+            : operation == "&" ? DiskSet::intersection(setA, setB)
+            : DiskSet::difference(setA, setB);
+
+        if (resultName.empty()) {
+            *out << "%" << setNameA << " " << operation << " %" << setNameB << " = ";
+            result.printElements(*out);
+            return;
+        }
+
+        int index = findDiskSetIndex(resultName);
+        if (index == -1) {
+            diskSets.emplace_back(resultName, std::move(result));
+        }
+        else {
+            diskSets[index].second = std::move(result);
+        }
+        *out << "%" << resultName << " = %" << setNameA << " " << operation << " %" << setNameB
+            << " stored successfully." << std::endl;
+    }
+
+    void showDictionary() {
+        *out << "Dictionary: " << dictionary.getSize() << " strings, "
+            << dictionary.memoryUsage() << " bytes" << std::endl;
+        for (const auto& set : stringSets) {
+            *out << "  $" << set.getName() << ": " << set.getSize() << " strings, "
+                << (set.isDense() ? "bitmap " : "sorted ids ") << set.memoryUsage() << " bytes" << std::endl;
+        }
+    }
+
+    void createRelation(const std::string& name, const std::string& setNameA, const std::string& setNameB, bool cartesian) {
+        int indexA = findSetIndex(setNameA);
+        int indexB = findSetIndex(setNameB);
+
+        if (indexA == -1 || indexB == -1) {
+            *out << "One or both sets not found!" << std::endl;
+            return;
+        }
+
+        if (cartesian) {
+            storeRelation(Relation::cartesianProduct(name, sets()[indexA], sets()[indexB]));
+        }
+        else {
+            storeRelation(Relation(name, sets()[indexA], sets()[indexB]));
+        }
+        *out << "Relation " << name << " on " << setNameA << " x " << setNameB << " created successfully." << std::endl;
+    }
+
+    void deleteRelation(const std::string& name) {
+        int index = findRelationIndex(name);
+        if (index == -1) {
+            *out << "Relation " << name << " not found!" << std::endl;
+            return;
+        }
+        relations.erase(relations.begin() + index);
+        *out << "Relation " << name << " deleted successfully." << std::endl;
+    }
+
+    void addPair(const std::string& name, char x, char y) {
+        int index = findRelationIndex(name);
+        if (index == -1) {
+            *out << "Relation " << name << " not found!" << std::endl;
+            return;
+        }
+        relations[index].addPair(x, y);
+        *out << "Pair (" << x << ", " << y << ") added to relation " << name << std::endl;
+    }
+
+    void showRelation(const std::string& name) {
+        int index = findRelationIndex(name);
+        if (index == -1) {
+            *out << "Relation " << name << " not found!" << std::endl;
+            return;
+        }
+        relations[index].print(*out);
+    }
+
+    void composeRelations(const std::string& resultName, const std::string& nameR, const std::string& nameS) {
+        int indexR = findRelationIndex(nameR);
+        int indexS = findRelationIndex(nameS);
+
+        if (indexR == -1 || indexS == -1) {
+            *out << "One or both relations not found!" << std::endl;
+            return;
+        }
+
+        Relation result = Relation::compose(resultName, relations[indexR], relations[indexS]);
+        storeRelation(result);
+        *out << nameR << " o " << nameS << " -> ";
+        result.print(*out);
+    }
+
+    void closeRelation(const std::string& resultName, const std::string& name) {
+        int index = findRelationIndex(name);
+        if (index == -1) {
+            *out << "Relation " << name << " not found!" << std::endl;
+            return;
+        }
+
+        Relation result = Relation::transitiveClosure(resultName, relations[index]);
+        storeRelation(result);
+        *out << "closure of " << name << " -> ";
+        result.print(*out);
+    }
+
+    void showRelationProperties(const std::string& name) {
+        int index = findRelationIndex(name);
+        if (index == -1) {
+            *out << "Relation " << name << " not found!" << std::endl;
+            return;
+        }
+
+        const Relation& relation = relations[index];
+        bool reflexive = relation.isReflexive();
+        bool symmetric = relation.isSymmetric();
+        bool transitive = relation.isTransitive();
+        *out << name << ": reflexive = " << (reflexive ? "true" : "false")
+            << ", symmetric = " << (symmetric ? "true" : "false")
+            << ", transitive = " << (transitive ? "true" : "false") << std::endl;
+    }
+
+    bool setExists(const std::string& name) {
+        return findSetIndex(name) != -1;
+    }
+
+    const std::vector<Set>& getSets() const {
+        return sets();
+    }
+};
+
+//очередь для одного производителя и одного потребителя: обмен идёт через атомарные индексы,
+//а мьютекс и условная переменная нужны, только чтобы уснуть на пустой или полной очереди
+template <typename T>
+class SpscQueue {
+private:
+    static const int SPIN_LIMIT = 64;
+
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head;   //следующий слот для чтения
+    alignas(64) std::atomic<size_t> tail;   //следующий слот для записи
+    std::atomic<int> sleepers;
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    //сначала короткое ожидание с уступкой процессора, затем сон до сдвига индекса другой стороной.
+    //Индексы и счётчик спящих упорядочены последовательно, поэтому пробуждение не теряется
+    template <typename Ready>
+    void await(Ready ready) {
+        for (int i = 0; i < SPIN_LIMIT; i++) {
+            if (ready()) return;
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        sleepers.fetch_add(1);
+        changed.wait(lock, ready);
+        sleepers.fetch_sub(1);
+    }
+
+    void wake() {
+        if (sleepers.load() != 0) {
+            { std::lock_guard<std::mutex> lock(mutex); }
+            changed.notify_all();
+        }
+    }
+
+public:
+    explicit SpscQueue(size_t capacity) : mask(0), head(0), tail(0), sleepers(0) {
+        size_t rounded = 1;
+        while (rounded < capacity) rounded <<= 1;
+        slots.resize(rounded);
+        mask = rounded - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    void push(T value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        await([&] { return t - head.load() != slots.size(); });
+        slots[t & mask] = std::move(value);
+        tail.store(t + 1);
+        wake();
+    }
+
+    T pop() {
+        size_t h = head.load(std::memory_order_relaxed);
+        await([&] { return tail.load() != h; });
+        T value = std::move(slots[h & mask]);
+        head.store(h + 1);
+        wake();
+        return value;
+    }
+};
+
+enum CommandKind {
+    CMD_NONE, CMD_NEW, CMD_DEL, CMD_ADD, CMD_REM, CMD_POW, CMD_POW_K, CMD_POW_SLICE, CMD_POW_RANK,
+    CMD_POW_SAMPLE, CMD_SEE_ALL, CMD_SEE_ONE, CMD_SEE_RANGE, CMD_RANK, CMD_SELECT, CMD_OPERATION,
+    CMD_REL, CMD_PAIR, CMD_COMP, CMD_CLOS, CMD_PROPS, CMD_SEE_REL, CMD_DEL_REL, CMD_DEMO, CMD_HELP,
+    CMD_MEM, CMD_STR_NEW, CMD_STR_DEL, CMD_STR_ADD, CMD_STR_REM, CMD_STR_SEE, CMD_STR_OPERATION, CMD_DICT,
+    CMD_DISK_NEW, CMD_DISK_DEL, CMD_DISK_ADD, CMD_DISK_ADD_RANGE, CMD_DISK_SEE, CMD_DISK_OPERATION,
+    CMD_DISK_STORE, CMD_CACHE, CMD_HAS, CMD_BENCH, CMD_TRACE,
+    CMD_SNAP, CMD_SNAPS, CMD_DROP, CMD_SEE_AT, CMD_OPERATION_AT,
+    CMD_SHARE, CMD_DETACH, CMD_SHARED_SEE, CMD_SHARED_OPERATION, CMD_UNKNOWN, CMD_INVALID, CMD_EXIT
+};
+
+//разобранная команда: вид и группы регулярного выражения; для CMD_INVALID в text – текст ошибки разбора
+struct ParsedCommand {
+    CommandKind kind = CMD_NONE;
+    std::string text;
+    std::vector<std::string> args;
+};
+
+//параметры синтетической нагрузки; задаются в командной строке как key=value
+struct WorkloadConfig {
+    //элементы нагрузки: a-z и 0-9
+    static const int WORKLOAD_ELEMENTS = 36;
+
+    uint64_t seed = 1;
+    size_t commands = 100000;
+    int sets = 8;           //множества A, B, ... (не больше 26)
+    int setSize = 24;       //предельный размер множества
+    double skew = 1.0;      //показатель закона Ципфа при выборе множества, 0 – равномерно
+    //относительные доли команд
+    unsigned newWeight = 2;
+    unsigned addWeight = 40;
+    unsigned remWeight = 15;
+    unsigned seeWeight = 15;
+    unsigned operationWeight = 25;
+    unsigned powWeight = 3;
+
+    //seed=, commands=, sets=, size=, skew=, mix=new:2,add:40,rem:15,see:15,op:25,pow:3
+    static WorkloadConfig parse(const std::vector<std::string>& options) {
+        WorkloadConfig config;
+        for (const std::string& option : options) {
+            size_t eq = option.find('=');
+            if (eq == std::string::npos) {
+                throw std::invalid_argument("Workload option must look like key=value: " + option);
+            }
+            std::string key = option.substr(0, eq);
+            std::string value = option.substr(eq + 1);
+
+            if (key == "seed") config.seed = std::stoull(value);
+            else if (key == "commands") config.commands = std::stoull(value);
+            else if (key == "sets") config.sets = std::stoi(value);
+            else if (key == "size") config.setSize = std::stoi(value);
+            else if (key == "skew") config.skew = std::stod(value);
+            else if (key == "mix") config.parseMix(value);
+            else throw std::invalid_argument("Unknown workload option: " + key);
+        }
+
+        if (config.sets < 1 || config.sets > 26) {
+            throw std::out_of_range("Number of sets must be in the 1-26 range");
+        }
+        if (config.setSize < 1 || config.setSize > WORKLOAD_ELEMENTS) {
+            throw std::out_of_range("Set size must be in the 1-" + std::to_string(WORKLOAD_ELEMENTS) + " range");
+        }
+        if (config.skew < 0) {
+            throw std::out_of_range("Skew must not be negative");
+        }
+        if (config.newWeight + config.addWeight + config.remWeight + config.seeWeight
+            + config.operationWeight + config.powWeight == 0) {
+            throw std::invalid_argument("Command mix must not be empty");
+        }
+        return config;
+    }
+
+private:
+    void parseMix(const std::string& mix) {
+        newWeight = addWeight = remWeight = seeWeight = operationWeight = powWeight = 0;
+        std::stringstream items(mix);
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            size_t colon = item.find(':');
+            if (colon == std::string::npos) {
+                throw std::invalid_argument("Mix entry must look like name:weight: " + item);
+            }
+            std::string name = item.substr(0, colon);
+            unsigned weight = static_cast<unsigned>(std::stoul(item.substr(colon + 1)));
+
+            if (name == "new") newWeight = weight;
+            else if (name == "add") addWeight = weight;
+            else if (name == "rem") remWeight = weight;
+            else if (name == "see") seeWeight = weight;
+            else if (name == "op") operationWeight = weight;
+            else if (name == "pow") powWeight = weight;
+            else throw std::invalid_argument("Unknown command in mix: " + name);
+        }
+    }
+};
+
+//детерминированный поток команд: генератор ведёт свою модель множеств, поэтому
+//add/rem меняют содержимое, а pow без аргументов выдаётся только для малых множеств.
+//Случайные числа берутся прямо из mt19937_64 без std::*_distribution, чьи алгоритмы
+//зависят от реализации библиотеки: один и тот же seed даёт одинаковый поток везде
+class WorkloadGenerator {
+private:
+    //полный булеан выводится для множеств не больше этого размера
+    static const int FULL_POWER_SET_LIMIT = 8;
+
+    WorkloadConfig config;
+    std::mt19937_64 rng;
+    std::vector<double> setWeights;     //накопленные веса Ципфа
+    std::vector<bool> exists;
+    std::vector<uint64_t> contents;     //бит e – элемент elementName(e)
+
+    static char elementName(int e) {
+        return e < 26 ? static_cast<char>('a' + e) : static_cast<char>('0' + e - 26);
+    }
+
+    static std::string setName(int s) {
+        return std::string(1, static_cast<char>('A' + s));
+    }
+
+    uint64_t below(uint64_t n) {
+        return rng() % n;
+    }
+
+    double unit() {
+        return (rng() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    int pickSet() {
+        double r = unit() * setWeights.back();
+        return static_cast<int>(std::upper_bound(setWeights.begin(), setWeights.end(), r) - setWeights.begin());
+    }
+
+    int pickExistingSet() {
+        for (int attempt = 0; attempt < 4 * config.sets; attempt++) {
+            int s = pickSet();
+            if (exists[s]) return s;
+        }
+        return -1;
+    }
+
+    //случайный элемент, который есть (present) или которого нет в множестве s
+    int pickElement(int s, bool present) {
+        uint64_t candidates = present ? contents[s] : ~contents[s] & ((uint64_t(1) << WorkloadConfig::WORKLOAD_ELEMENTS) - 1);
+        uint64_t k = below(popCount(candidates));
+        for (; k > 0; k--) candidates &= candidates - 1;
+        return lowestBit(candidates);
+    }
+
+    void create(int s, std::vector<std::string>& stream) {
+        stream.push_back("new " + setName(s));
+        exists[s] = true;
+        contents[s] = 0;
+        int size = 1 + static_cast<int>(below(config.setSize));
+        for (int i = 0; i < size; i++) {
+            int e = pickElement(s, false);
+            stream.push_back("add " + setName(s) + " " + elementName(e));
+            contents[s] |= uint64_t(1) << e;
+        }
+    }
+
+public:
+    explicit WorkloadGenerator(const WorkloadConfig& workload)
+        : config(workload), rng(workload.seed), exists(workload.sets, false), contents(workload.sets, 0) {
+        double total = 0;
+        for (int s = 0; s < config.sets; s++) {
+            total += 1.0 / std::pow(s + 1.0, config.skew);
+            setWeights.push_back(total);
+        }
+    }
+
+    //сначала создаются и заполняются все множества, затем идут config.commands команд смеси
+    std::vector<std::string> generate() {
+        std::vector<std::string> stream;
+        for (int s = 0; s < config.sets; s++) {
+            create(s, stream);
+        }
+
+        const unsigned weights[] = { config.newWeight, config.addWeight, config.remWeight,
+            config.seeWeight, config.operationWeight, config.powWeight };
+        unsigned total = 0;
+        for (unsigned w : weights) total += w;
+
+        static const char operations[] = { '+', '&', '-', '<', '=' };
+        size_t end = stream.size() + config.commands;
+        while (stream.size() < end) {
+            unsigned r = static_cast<unsigned>(below(total));
+            int kind = 0;
+            while (r >= weights[kind]) r -= weights[kind++];
+
+            int s = kind == 0 ? pickSet() : pickExistingSet();
+            if (s == -1) {
+                stream.push_back("see");
+                continue;
+            }
+            std::string name = setName(s);
+            int size = popCount(contents[s]);
+
+            switch (kind) {
+            case 0:
+                //пересоздание: удаление существующего множества или новое с заполнением
+                if (exists[s]) {
+                    stream.push_back("del " + name);
+                    exists[s] = false;
+                }
+                else {
+                    create(s, stream);
+                }
+                break;
+            case 1:
+            case 2: {
+                //при достижении предельного размера add сменяется на rem, у пустого – наоборот
+                bool add = size == 0 || (kind == 1 && size < config.setSize);
+                int e = pickElement(s, !add);
+                stream.push_back((add ? "add " : "rem ") + name + " " + elementName(e));
+                contents[s] ^= uint64_t(1) << e;
+                break;
+            }
+            case 3:
+                stream.push_back("see " + name);
+                break;
+            case 4: {
+                int other = pickExistingSet();
+                if (other == -1) other = s;
+                stream.push_back(name + " " + operations[below(5)] + " " + setName(other));
+                break;
+            }
+            default:
+                if (size <= FULL_POWER_SET_LIMIT) stream.push_back("pow " + name);
+                else if (below(2) == 0) stream.push_back("pow " + name + " k=2");
+                else stream.push_back("pow " + name + " sample 4");
+                break;
+            }
+        }
+        stream.resize(end);
+        return stream;
+    }
+};
+
+class CommandProcessor {
+private:
+    //ёмкость очередей между стадиями конвейера
+    static const size_t PIPELINE_CAPACITY = 1024;
+
+    struct OutputChunk {
+        std::string text;
+        bool last = false;
+    };
+
+    SetManager manager;
+    std::ostream* out = &std::cout;
+
+    void trace(const std::string& action, const std::string& fileName) {
+        if (action == "on") {
+            Tracer::start();
+            *out << "Tracing enabled" << std::endl;
+        }
+        else if (action == "off") {
+            Tracer::stop();
+            *out << "Tracing disabled" << std::endl;
+        }
+        else {
+            if (fileName.empty()) {
+                throw std::invalid_argument("trace save requires a file name");
+            }
+            std::ofstream file(fileName);
+            if (!file) {
+                throw std::runtime_error("Cannot open " + fileName);
+            }
+            size_t events = Tracer::write(file);
+            *out << events << " trace events written to " << fileName;
+            if (Tracer::getDropped() > 0) *out << " (" << Tracer::getDropped() << " dropped)";
+            *out << std::endl;
+        }
+    }
+
+    void printHelp() {
+        *out << "\n=== Available Commands ===\n";
+        *out << "new A           - Create new set A (A-Z)\n";
+        *out << "del A           - Delete set A\n";
+        *out << "add A x         - Add element x to set A\n";
+        *out << "rem A x         - Remove element x from set A\n";
+        *out << "pow A           - Show power set of A\n";
+        *out << "pow A k=m       - Show subsets of A with m elements\n";
+        *out << "pow A #i[..j]   - Show subsets number i..j of A (from 0)\n";
+        *out << "pow A rank B    - Show number of subset B in power set of A\n";
+        *out << "pow A sample m  - Show m random subsets of A\n";
+        *out << "mem [A]         - Show memory usage of sets\n";
+        *out << "cache           - Show operation cache statistics\n";
+        *out << "bench [n]       - Benchmark merge kernels and parallel merges on n-element arrays\n";
+        *out << "snap            - Take a snapshot of all sets (@vN)\n";
+        *out << "snaps / drop @vN - List snapshots / release snapshot @vN\n";
+        *out << "see [A] @vN     - Show sets as of version N\n";
+        *out << "A + B @vN       - Set operation as of version N (also &, -, <, =)\n";
+        *out << "share name      - Publish sets A-Z to shared memory /name (writer)\n";
+        *out << "attach name     - Map shared memory /name read-only; detach - unmap\n";
+        *out << "see *[A], *A + *B - Query sets published in shared memory\n";
+        *out << "trace on|off    - Start / stop recording command spans\n";
+        *out << "trace save file - Write recorded spans as Chrome trace JSON\n";
+        *out << "new $A          - Create new set of strings $A\n";
+        *out << "add $A s1 s2 .. - Add strings to set $A\n";
+        *out << "rem $A s        - Remove string s from set $A\n";
+        *out << "see $A / del $A - Show / delete set of strings $A\n";
+        *out << "$A + $B ...     - Operations (+ & - < =) on sets of strings\n";
+        *out << "dict            - Show string dictionary statistics\n";
+        *out << "new %A / del %A - Create / delete disk-backed set of integers %A\n";
+        *out << "add %A 1 2 ..   - Add integers to set %A\n";
+        *out << "add %A x..y[/s] - Add integers x..y (with step s) to set %A\n";
+        *out << "see %A          - Stream elements of set %A\n";
+        *out << "%A + %B ...     - Operations (+ & - < =) on disk-backed sets\n";
+        *out << "%C = %A + %B    - Store result of + & - as disk-backed set %C\n";
+        *out << "see             - Show all sets\n";
+        *out << "see A           - Show set A\n";
+        *out << "see A [x..y]    - Show elements of A in range [x, y]\n";
+        *out << "rank A x        - Count elements of A less than x\n";
+        *out << "has A xyz       - Test membership of each of x, y, z (bitmask)\n";
+        *out << "select A k      - Show k-th smallest element of A (from 0)\n";
+        *out << "A + B           - Union of sets A and B\n";
+        *out << "A & B           - Intersection of sets A and B\n";
+        *out << "A - B           - Difference of sets A and B\n";
+        *out << "A < B           - Check if A is subset of B\n";
+        *out << "A = B           - Check if A equals B\n";
+        *out << "rel r A B       - Create empty relation r on A x B (a-z)\n";
+        *out << "prod r A B      - Create relation r = A x B\n";
+        *out << "pair r x y      - Add pair (x, y) to relation r\n";
+        *out << "comp t r s      - t = composition of r and s\n";
+        *out << "clos t r        - t = transitive closure of r\n";
+        *out << "props r         - Check reflexive/symmetric/transitive\n";
+        *out << "see r / del r   - Show / delete relation r\n";
+        *out << "demo            - Auto demonstration\n";
+        *out << "help            - Show this help\n";
+        *out << "exit            - Exit program\n";
+        *out << "==========================\n\n";
+    }
+
+    void autoDemo() {
+        *out << "=== Automatic Demonstration ===" << std::endl;
+
+        SetManager manager;
+        manager.setOutput(*out);
+
+        //создание
+        manager.createSet("A");
+        manager.createSet("B");
+        manager.createSet("C");
+
+        //добавление эл
+        manager.addElement("A", 'a');
+        manager.addElement("A", 'c');
+        manager.addElement("A", 'e');
+        manager.addElement("A", 'g');
+
+        manager.addElement("B", 'b');
+        manager.addElement("B", 'c');
+        manager.addElement("B", 'd');
+        manager.addElement("B", 'e');
+
+        manager.addElement("C", 'a');
+        manager.addElement("C", 'e');
+
+        //все множества
+        manager.showSets();
+
+        //операции
+        *out << "\n--- Set Operations ---" << std::endl;
         manager.performOperation("+", "A", "B"); //объединение
         manager.performOperation("&", "A", "B"); //пересечение
         manager.performOperation("-", "A", "B"); //разность
@@ -534,74 +2965,367 @@ private:
         manager.performOperation("=", "A", "B"); //равенство
 
         //булеан
-        std::cout << "\n--- Power Set Demo ---" << std::endl;
+        *out << "\n--- Power Set Demo ---" << std::endl;
         SetManager tempManager;
+        tempManager.setOutput(*out);
         tempManager.createSet("X");
         tempManager.addElement("X", 'x');
         tempManager.addElement("X", 'y');
         tempManager.showPowerSet("X");
 
-        std::cout << "\n=== Demonstration Complete ===" << std::endl;
+        *out << "\n=== Demonstration Complete ===" << std::endl;
     }
 
-    void processCommand(const std::string& input) {
-        std::string trimmed = input;
-        trimmed.erase(0, trimmed.find_first_not_of(" \t"));
-        trimmed.erase(trimmed.find_last_not_of(" \t") + 1);
-
-        if (trimmed.empty()) return;
-
-        //регулярные выражения для команд
-        std::regex new_pattern(R"(^\s*new\s+([A-Z])\s*$)");
-        std::regex del_pattern(R"(^\s*del\s+([A-Z])\s*$)");
-        std::regex add_pattern(R"(^\s*add\s+([A-Z])\s+(\S)\s*$)");
-        std::regex rem_pattern(R"(^\s*rem\s+([A-Z])\s+(\S)\s*$)");
-        std::regex pow_pattern(R"(^\s*pow\s+([A-Z])\s*$)");
-        std::regex see_all_pattern(R"(^\s*see\s*$)");
-        std::regex see_one_pattern(R"(^\s*see\s+([A-Z])\s*$)");
-        std::regex operation_pattern(R"(^\s*([A-Za-z])\s*([+&=<\-])\s*([A-Za-z])\s*$)");
-        std::regex help_pattern(R"(^\s*help\s*$)");
+    //регулярные выражения для команд, компилируются один раз
+    static const std::vector<std::pair<CommandKind, std::regex>>& commandPatterns() {
+        static const std::vector<std::pair<CommandKind, std::regex>> patterns = {
+            { CMD_NEW, std::regex(R"(^\s*new\s+([A-Z])\s*$)") },
+            { CMD_DEL, std::regex(R"(^\s*del\s+([A-Z])\s*$)") },
+            { CMD_ADD, std::regex(R"(^\s*add\s+([A-Z])\s+(\S)\s*$)") },
+            { CMD_REM, std::regex(R"(^\s*rem\s+([A-Z])\s+(\S)\s*$)") },
+            { CMD_POW, std::regex(R"(^\s*pow\s+([A-Z])\s*$)") },
+            { CMD_POW_K, std::regex(R"(^\s*pow\s+([A-Z])\s+k\s*=\s*(\d{1,9})\s*$)") },
+            { CMD_POW_SLICE, std::regex(R"(^\s*pow\s+([A-Z])\s+#(\d{1,19})(?:\s*\.\.\s*(\d{1,19}))?\s*$)") },
+            { CMD_POW_RANK, std::regex(R"(^\s*pow\s+([A-Z])\s+rank\s+([A-Z])\s*$)") },
+            { CMD_POW_SAMPLE, std::regex(R"(^\s*pow\s+([A-Z])\s+sample\s+(\d{1,9})\s*$)") },
+            { CMD_SEE_ALL, std::regex(R"(^\s*see\s*$)") },
+            { CMD_SEE_ONE, std::regex(R"(^\s*see\s+([A-Z])\s*$)") },
+            { CMD_SEE_RANGE, std::regex(R"(^\s*see\s+([A-Z])\s*\[\s*(\S)\s*\.\.\s*(\S)\s*\]\s*$)") },
+            { CMD_RANK, std::regex(R"(^\s*rank\s+([A-Z])\s+(\S)\s*$)") },
+            { CMD_SELECT, std::regex(R"(^\s*select\s+([A-Z])\s+(\d{1,9})\s*$)") },
+            { CMD_OPERATION, std::regex(R"(^\s*([A-Za-z])\s*([+&=<\-])\s*([A-Za-z])\s*$)") },
+            { CMD_OPERATION_AT, std::regex(R"(^\s*([A-Z])\s*([+&=<\-])\s*([A-Z])\s+@v(\d{1,19})\s*$)") },
+            { CMD_SEE_AT, std::regex(R"(^\s*see(?:\s+([A-Z]))?\s+@v(\d{1,19})\s*$)") },
+            { CMD_SNAP, std::regex(R"(^\s*snap\s*$)") },
+            { CMD_SNAPS, std::regex(R"(^\s*snaps\s*$)") },
+            { CMD_DROP, std::regex(R"(^\s*drop\s+@v(\d{1,19})\s*$)") },
+            { CMD_SHARE, std::regex(R"(^\s*(share|attach)\s+([A-Za-z0-9_.\-]{1,64})\s*$)") },
+            { CMD_DETACH, std::regex(R"(^\s*detach\s*$)") },
+            { CMD_SHARED_SEE, std::regex(R"(^\s*see\s+\*([A-Z])?\s*$)") },
+            { CMD_SHARED_OPERATION, std::regex(R"(^\s*\*([A-Z])\s*([+&=<\-])\s*\*([A-Z])\s*$)") },
+            { CMD_REL, std::regex(R"(^\s*(rel|prod)\s+([a-z])\s+([A-Z])\s+([A-Z])\s*$)") },
+            { CMD_PAIR, std::regex(R"(^\s*pair\s+([a-z])\s+(\S)\s+(\S)\s*$)") },
+            { CMD_COMP, std::regex(R"(^\s*comp\s+([a-z])\s+([a-z])\s+([a-z])\s*$)") },
+            { CMD_CLOS, std::regex(R"(^\s*clos\s+([a-z])\s+([a-z])\s*$)") },
+            { CMD_PROPS, std::regex(R"(^\s*props\s+([a-z])\s*$)") },
+            { CMD_SEE_REL, std::regex(R"(^\s*see\s+([a-z])\s*$)") },
+            { CMD_DEL_REL, std::regex(R"(^\s*del\s+([a-z])\s*$)") },
+            { CMD_MEM, std::regex(R"(^\s*mem(?:\s+([A-Z]))?\s*$)") },
+            { CMD_CACHE, std::regex(R"(^\s*cache\s*$)") },
+            { CMD_BENCH, std::regex(R"(^\s*bench(?:\s+(\d{1,9}))?\s*$)") },
+            { CMD_TRACE, std::regex(R"(^\s*trace\s+(on|off|save)(?:\s+(\S+))?\s*$)") },
+            { CMD_STR_NEW, std::regex(R"(^\s*new\s+\$([A-Z])\s*$)") },
+            { CMD_STR_DEL, std::regex(R"(^\s*del\s+\$([A-Z])\s*$)") },
+            { CMD_STR_REM, std::regex(R"(^\s*rem\s+\$([A-Z])\s+(\S+)\s*$)") },
+            { CMD_STR_SEE, std::regex(R"(^\s*see\s+\$([A-Z])\s*$)") },
+            { CMD_STR_OPERATION, std::regex(R"(^\s*\$([A-Z])\s*([+&=<\-])\s*\$([A-Z])\s*$)") },
+            { CMD_DICT, std::regex(R"(^\s*dict\s*$)") },
+            { CMD_DISK_NEW, std::regex(R"(^\s*new\s+%([A-Z])\s*$)") },
+            { CMD_DISK_DEL, std::regex(R"(^\s*del\s+%([A-Z])\s*$)") },
+            { CMD_DISK_ADD_RANGE, std::regex(R"(^\s*add\s+%([A-Z])\s+(\d{1,10})\s*\.\.\s*(\d{1,10})(?:\s*/\s*(\d{1,10}))?\s*$)") },
+            { CMD_DISK_SEE, std::regex(R"(^\s*see\s+%([A-Z])\s*$)") },
+            { CMD_DISK_OPERATION, std::regex(R"(^\s*%([A-Z])\s*([+&=<\-])\s*%([A-Z])\s*$)") },
+            { CMD_DISK_STORE, std::regex(R"(^\s*%([A-Z])\s*=\s*%([A-Z])\s*([+&\-])\s*%([A-Z])\s*$)") }
+        };
+        return patterns;
+    }
 
-        std::smatch matches;
+    //команда со списком аргументов произвольной длины: регулярное выражение разбирает только
+    //заголовок, а остаток строки передаётся последним аргументом и делится на слова вручную.
+    //Повторение группы по всему списку в std::regex рекурсивно и переполняет стек на длинных строках
+    struct PayloadPattern {
+        CommandKind kind;
+        std::regex prefix;
+        bool (*accepts)(const std::string& payload);
+    };
+
+    static const std::vector<PayloadPattern>& payloadPatterns() {
+        static const std::vector<PayloadPattern> patterns = {
+            { CMD_HAS, std::regex(R"(^\s*has\s+([A-Z])\s)"), isNonEmpty },
+            { CMD_STR_ADD, std::regex(R"(^\s*add\s+\$([A-Z])\s)"), isNonEmpty },
+            { CMD_DISK_ADD, std::regex(R"(^\s*add\s+%([A-Z])\s)"), isNumberList }
+        };
+        return patterns;
+    }
 
-        try {
-            if (std::regex_match(trimmed, matches, new_pattern)) {
-                manager.createSet(matches[1]);
-            }
-            else if (std::regex_match(trimmed, matches, del_pattern)) {
-                manager.deleteSet(matches[1]);
-            }
-            else if (std::regex_match(trimmed, matches, add_pattern)) {
-                manager.addElement(matches[1], matches[2].str()[0]);
+    static bool isNonEmpty(const std::string& payload) {
+        return !payload.empty();
+    }
+
+    //непустой список чисел до 10 цифр через пробелы
+    static bool isNumberList(const std::string& payload) {
+        std::istringstream numbers(payload);
+        bool any = false;
+        for (std::string number; numbers >> number; any = true) {
+            if (number.size() > 10 || number.find_first_not_of("0123456789") != std::string::npos) return false;
+        }
+        return any;
+    }
+
+    static uint32_t parseValue(const std::string& text) {
+        unsigned long long value = std::stoull(text);
+        if (value > UINT32_MAX) {
+            throw std::out_of_range("Value must fit in 32 bits");
+        }
+        return static_cast<uint32_t>(value);
+    }
+
+    static ParsedCommand parseCommand(const std::string& input) {
+        TraceSpan span("parse");
+        ParsedCommand command;
+        command.text = input;
+        command.text.erase(0, command.text.find_first_not_of(" \t"));
+        command.text.erase(command.text.find_last_not_of(" \t") + 1);
+
+        if (command.text.empty()) return command;
+
+        std::smatch matches;
+        for (const auto& pattern : commandPatterns()) {
+            if (std::regex_match(command.text, matches, pattern.second)) {
+                command.kind = pattern.first;
+                for (size_t i = 1; i < matches.size(); i++) {
+                    command.args.push_back(matches[i]);
+                }
+                return command;
             }
-            else if (std::regex_match(trimmed, matches, rem_pattern)) {
-                manager.removeElement(matches[1], matches[2].str()[0]);
+        }
+
+        for (const auto& pattern : payloadPatterns()) {
+            if (std::regex_search(command.text, matches, pattern.prefix, std::regex_constants::match_continuous)) {
+                std::string payload = matches.suffix().str();
+                payload.erase(0, payload.find_first_not_of(" \t"));
+                if (!pattern.accepts(payload)) continue;
+
+                command.kind = pattern.kind;
+                for (size_t i = 1; i < matches.size(); i++) {
+                    command.args.push_back(matches[i]);
+                }
+                command.args.push_back(payload);
+                return command;
             }
-            else if (std::regex_match(trimmed, matches, pow_pattern)) {
-                manager.showPowerSet(matches[1]);
+        }
+
+        if (input == "demo") {
+            command.kind = CMD_DEMO;
+        }
+        else if (input == "help") {
+            command.kind = CMD_HELP;
+        }
+        else {
+            command.kind = CMD_UNKNOWN;
+        }
+        return command;
+    }
+
+    void executeCommand(const ParsedCommand& command) {
+        TraceSpan span("execute");
+        const std::vector<std::string>& args = command.args;
+
+        try {
+            switch (command.kind) {
+            case CMD_NEW:
+                manager.createSet(args[0]);
+                break;
+            case CMD_DEL:
+                manager.deleteSet(args[0]);
+                break;
+            case CMD_ADD:
+                manager.addElement(args[0], args[1][0]);
+                break;
+            case CMD_REM:
+                manager.removeElement(args[0], args[1][0]);
+                break;
+            case CMD_POW:
+                manager.showPowerSet(args[0]);
+                break;
+            case CMD_POW_K:
+                manager.showSubsets(args[0], std::stoi(args[1]));
+                break;
+            case CMD_POW_SLICE: {
+                uint64_t from = std::stoull(args[1]);
+                uint64_t to = args[2].empty() ? from : std::stoull(args[2]);
+                manager.showPowerSetSlice(args[0], from, to);
+                break;
             }
-            else if (std::regex_match(trimmed, matches, see_all_pattern)) {
+            case CMD_POW_RANK:
+                manager.showSubsetIndex(args[0], args[1]);
+                break;
+            case CMD_POW_SAMPLE:
+                manager.showRandomSubsets(args[0], std::stoi(args[1]));
+                break;
+            case CMD_SEE_ALL:
                 manager.showSets();
+                break;
+            case CMD_SEE_ONE:
+                manager.showSets(args[0]);
+                break;
+            case CMD_SEE_RANGE:
+                manager.showRange(args[0], args[1][0], args[2][0]);
+                break;
+            case CMD_RANK:
+                manager.showRank(args[0], args[1][0]);
+                break;
+            case CMD_HAS: {
+                std::string elements = args[1];
+                elements.erase(std::remove_if(elements.begin(), elements.end(),
+                    [](unsigned char c) { return std::isspace(c) != 0; }), elements.end());
+                manager.showMembership(args[0], elements);
+                break;
             }
-            else if (std::regex_match(trimmed, matches, see_one_pattern)) {
-                manager.showSets(matches[1]);
+            case CMD_SELECT:
+                manager.showSelect(args[0], std::stoi(args[1]));
+                break;
+            case CMD_OPERATION:
+                manager.performOperation(args[1], args[0], args[2]);
+                break;
+            case CMD_REL:
+                manager.createRelation(args[1], args[2], args[3], args[0] == "prod");
+                break;
+            case CMD_PAIR:
+                manager.addPair(args[0], args[1][0], args[2][0]);
+                break;
+            case CMD_COMP:
+                manager.composeRelations(args[0], args[1], args[2]);
+                break;
+            case CMD_CLOS:
+                manager.closeRelation(args[0], args[1]);
+                break;
+            case CMD_PROPS:
+                manager.showRelationProperties(args[0]);
+                break;
+            case CMD_SEE_REL:
+                manager.showRelation(args[0]);
+                break;
+            case CMD_DEL_REL:
+                manager.deleteRelation(args[0]);
+                break;
+            case CMD_MEM:
+                manager.showMemory(args[0]);
+                break;
+            case CMD_STR_NEW:
+                manager.createStringSet(args[0]);
+                break;
+            case CMD_STR_DEL:
+                manager.deleteStringSet(args[0]);
+                break;
+            case CMD_STR_ADD: {
+                std::istringstream words(args[1]);
+                std::vector<std::string> elements;
+                for (std::string word; words >> word;) {
+                    elements.push_back(word);
+                }
+                manager.addStrings(args[0], elements);
+                break;
             }
-            else if (std::regex_match(trimmed, matches, operation_pattern)) {
-                manager.performOperation(matches[2], matches[1], matches[3]);
+            case CMD_STR_REM:
+                manager.removeString(args[0], args[1]);
+                break;
+            case CMD_STR_SEE:
+                manager.showStringSet(args[0]);
+                break;
+            case CMD_STR_OPERATION:
+                manager.performStringOperation(args[1], args[0], args[2]);
+                break;
+            case CMD_DICT:
+                manager.showDictionary();
+                break;
+            case CMD_DISK_NEW:
+                manager.createDiskSet(args[0]);
+                break;
+            case CMD_DISK_DEL:
+                manager.deleteDiskSet(args[0]);
+                break;
+            case CMD_DISK_ADD: {
+                std::istringstream numbers(args[1]);
+                std::vector<uint32_t> values;
+                for (std::string number; numbers >> number;) {
+                    values.push_back(parseValue(number));
+                }
+                manager.addDiskElements(args[0], values);
+                break;
             }
-            else if (input == "demo") {
-                autoDemo();
+            case CMD_DISK_ADD_RANGE: {
+                uint32_t step = args[3].empty() ? 1 : parseValue(args[3]);
+                if (step == 0) {
+                    throw std::invalid_argument("Step must be positive");
+                }
+                manager.addDiskRange(args[0], parseValue(args[1]), parseValue(args[2]), step);
+                break;
             }
-            else if (input == "help") {
+            case CMD_DISK_SEE:
+                manager.showDiskSet(args[0]);
+                break;
+            case CMD_DISK_OPERATION:
+                manager.performDiskOperation(args[1], args[0], args[2]);
+                break;
+            case CMD_DISK_STORE:
+                manager.performDiskOperation(args[2], args[1], args[3], args[0]);
+                break;
+            case CMD_CACHE:
+                manager.showCacheStatistics();
+                break;
+            case CMD_BENCH:
+                benchmarkSortedKernels(*out, args[0].empty() ? size_t(1) << 20 : parseValue(args[0]));
+                break;
+            case CMD_SNAP:
+                manager.takeSnapshot();
+                break;
+            case CMD_SNAPS:
+                manager.showSnapshots();
+                break;
+            case CMD_DROP:
+                manager.dropSnapshot(std::stoull(args[0]));
+                break;
+            case CMD_SEE_AT:
+                manager.showSetsAt(args[0], std::stoull(args[1]));
+                break;
+            case CMD_OPERATION_AT:
+                manager.performOperationAt(args[1], args[0], args[2], std::stoull(args[3]));
+                break;
+            case CMD_SHARE:
+                manager.share(args[1], args[0] == "share");
+                break;
+            case CMD_DETACH:
+                manager.detach();
+                break;
+            case CMD_SHARED_SEE:
+                manager.showSharedSets(args[0]);
+                break;
+            case CMD_SHARED_OPERATION:
+                manager.performSharedOperation(args[1], args[0], args[2]);
+                break;
+            case CMD_TRACE:
+                trace(args[0], args[1]);
+                break;
+            case CMD_DEMO:
+                autoDemo();
+                break;
+            case CMD_HELP:
                 printHelp();
+                break;
+            case CMD_UNKNOWN:
+                *out << "Error: Unknown command '" << command.text << "'\n";
+                *out << "Type 'help' for available commands.\n";
+                break;
+            case CMD_INVALID:
+                *out << "Error: " << command.text << std::endl;
+                break;
+            default:
+                break;
             }
-            else {
-                std::cout << "Error: Unknown command '" << trimmed << "'\n";
-                std::cout << "Type 'help' for available commands.\n";
-            }
         }
         catch (const std::exception& e) {
-            std::cout << "Error: " << e.what() << std::endl;
+            *out << "Error: " << e.what() << std::endl;
+        }
+    }
+
+    void processCommand(const std::string& input) {
+        TraceSpan span("command");
+        try {
+            executeCommand(parseCommand(input));
+        }
+        catch (const std::exception& e) {
+            *out << "Error: " << e.what() << std::endl;
         }
     }
 
@@ -617,7 +3341,7 @@ public:
         std::string command;
         while (true) {
             std::cout << "> ";
-            std::getline(std::cin, command);
+            if (!std::getline(std::cin, command)) break;
 
             if (command == "exit") {
                 std::cout << "Goodbye!\n";
@@ -627,11 +3351,147 @@ public:
             processCommand(command);
         }
     }
+
+    //замер полного пути команды: разбор, поиск множеств, операция и форматирование вывода;
+    //вывод собирается в буфер и отбрасывается. Отчёт – команды в секунду и перцентили задержки
+    void runBenchmark(const std::vector<std::string>& commands, std::ostream& report) {
+        std::ostringstream buffer;
+        manager.setOutput(buffer);
+        out = &buffer;
+
+        std::vector<double> latencies;
+        latencies.reserve(commands.size());
+        size_t outputBytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const std::string& line : commands) {
+            if (line == "exit") break;
+            auto begin = std::chrono::steady_clock::now();
+            processCommand(line);
+            latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count());
+            outputBytes += static_cast<size_t>(static_cast<std::streamoff>(buffer.tellp()));
+            buffer.str("");
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        manager.setOutput(std::cout);
+        out = &std::cout;
+
+        if (latencies.empty()) {
+            report << "No commands to replay" << std::endl;
+            return;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double q) {
+            return latencies[std::min(latencies.size() - 1, static_cast<size_t>(q * latencies.size()))];
+        };
+        report << "Commands: " << latencies.size() << ", elapsed " << elapsed << " s, "
+            << static_cast<long long>(latencies.size() / std::max(elapsed, 1e-9)) << " commands/s, "
+            << outputBytes << " bytes of output\n";
+        report << "Latency (us): p50 " << percentile(0.5) << ", p99 " << percentile(0.99)
+            << ", p999 " << percentile(0.999) << ", max " << latencies.back() << std::endl;
+    }
+
+    //пакетное выполнение: чтение с разбором, выполнение и вывод идут в трёх потоках,
+    //связанных очередями; результаты выводятся в порядке поступления команд
+    void runPipeline(std::istream& input, std::ostream& output) {
+        SpscQueue<ParsedCommand> commands(PIPELINE_CAPACITY);
+        SpscQueue<OutputChunk> results(PIPELINE_CAPACITY);
+
+        std::thread parser([&] {
+            std::string line;
+            while (std::getline(input, line) && line != "exit") {
+                ParsedCommand command;
+                try {
+                    command = parseCommand(line);
+                }
+                catch (const std::exception& e) {
+                    //ошибка разбора выводится исполнителем, чтобы сохранить порядок вывода
+                    command.kind = CMD_INVALID;
+                    command.text = e.what();
+                }
+                if (command.kind != CMD_NONE) {
+                    commands.push(std::move(command));
+                }
+            }
+            ParsedCommand last;
+            last.kind = CMD_EXIT;
+            commands.push(std::move(last));
+        });
+
+        std::thread executor([&] {
+            std::ostringstream buffer;
+            manager.setOutput(buffer);
+            out = &buffer;
+
+            while (true) {
+                ParsedCommand command = commands.pop();
+                if (command.kind == CMD_EXIT) break;
+
+                executeCommand(command);
+                results.push(OutputChunk{ buffer.str(), false });
+                buffer.str("");
+            }
+
+            manager.setOutput(std::cout);
+            out = &std::cout;
+            results.push(OutputChunk{ "", true });
+        });
+
+        while (true) {
+            OutputChunk chunk = results.pop();
+            if (chunk.last) break;
+            output << chunk.text;
+        }
+        output.flush();
+
+        parser.join();
+        executor.join();
+    }
 };
 
-int main() {
+int main(int argc, char* argv[]) {
     CommandProcessor processor;
-    processor.demonstration();
+    std::string mode = argc > 1 ? argv[1] : "";
+
+    if (mode == "--pipeline") {
+        processor.runPipeline(std::cin, std::cout);
+    }
+    else if (mode == "--workload") {
+        std::vector<std::string> options(argv + 2, argv + argc);
+        auto emit = std::find(options.begin(), options.end(), "--emit");
+        bool emitOnly = emit != options.end();
+        if (emitOnly) options.erase(emit);
+
+        std::vector<std::string> commands;
+        try {
+            commands = WorkloadGenerator(WorkloadConfig::parse(options)).generate();
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+
+        if (emitOnly) {
+            for (const std::string& command : commands) std::cout << command << '\n';
+        }
+        else {
+            processor.runBenchmark(commands, std::cout);
+        }
+    }
+    else if (mode == "--replay" && argc > 2) {
+        std::ifstream file(argv[2]);
+        if (!file) {
+            std::cerr << "Error: cannot open " << argv[2] << std::endl;
+            return 1;
+        }
+        std::vector<std::string> commands;
+        std::string line;
+        while (std::getline(file, line)) commands.push_back(line);
+        processor.runBenchmark(commands, std::cout);
+    }
+    else {
+        processor.demonstration();
+    }
 
     return 0;
 }
@@ -0,0 +1,1033 @@
+#ifndef INT_SETS_H
+#define INT_SETS_H
+
+//множества целых для больших данных: слияние отсортированных последовательностей
+//через курсоры, сжатые неизменяемые представления (varint, Элиас–Фано), ядра слияния
+//отсортированных массивов и параллельное слияние в пуле потоков (SortedSet)
+
+#include "set_store.h"
+
+#include <condition_variable>
+#include <functional>
+#include <type_traits>
+
+//слияние отсортированных последовательностей через курсоры: value() – текущее значение,
+//advance() – следующее, skipTo(x) – первое значение ≥ x (может перескакивать целые блоки)
+template <typename CursorA, typename CursorB, typename Emit>
+void mergeUnion(CursorA a, CursorB b, Emit emit) {
+    while (!a.atEnd() && !b.atEnd()) {
+        if (a.value() < b.value()) {
+            emit(a.value());
+            a.advance();
+        }
+        else if (b.value() < a.value()) {
+            emit(b.value());
+            b.advance();
+        }
+        else {
+            emit(a.value());
+            a.advance();
+            b.advance();
+        }
+    }
+    for (; !a.atEnd(); a.advance()) emit(a.value());
+    for (; !b.atEnd(); b.advance()) emit(b.value());
+}
+
+template <typename CursorA, typename CursorB, typename Emit>
+void mergeIntersection(CursorA a, CursorB b, Emit emit) {
+    while (!a.atEnd() && !b.atEnd()) {
+        if (a.value() < b.value()) {
+            a.skipTo(b.value());
+        }
+        else if (b.value() < a.value()) {
+            b.skipTo(a.value());
+        }
+        else {
+            emit(a.value());
+            a.advance();
+            b.advance();
+        }
+    }
+}
+
+template <typename CursorA, typename CursorB, typename Emit>
+void mergeDifference(CursorA a, CursorB b, Emit emit) {
+    for (; !a.atEnd(); a.advance()) {
+        b.skipTo(a.value());
+        if (b.atEnd() || b.value() != a.value()) emit(a.value());
+    }
+}
+
+template <typename CursorA, typename CursorB>
+bool mergeIsSubset(CursorA a, CursorB b) {
+    for (; !a.atEnd(); a.advance()) {
+        b.skipTo(a.value());
+        if (b.atEnd() || b.value() != a.value()) return false;
+    }
+    return true;
+}
+
+//сжатое неизменяемое множество целых: разности соседних значений в varint, блоками по BLOCK;
+//таблица пропусков хранит первое значение и смещение каждого блока
+class VarintSet {
+public:
+    static const size_t BLOCK = 128;
+
+private:
+    struct Skip {
+        uint32_t first;
+        uint32_t offset;
+    };
+
+    std::vector<uint8_t> bytes;
+    std::vector<Skip> skips;
+    size_t count = 0;
+    uint32_t last = 0;
+
+    void append(uint32_t value) {
+        if (count > 0 && value <= last) {
+            throw std::invalid_argument("Values must be strictly increasing");
+        }
+
+        if (count % BLOCK == 0) {
+            skips.push_back(Skip{ value, static_cast<uint32_t>(bytes.size()) });
+        }
+        else {
+            uint32_t delta = value - last;
+            while (delta >= 0x80) {
+                bytes.push_back(static_cast<uint8_t>(delta | 0x80));
+                delta >>= 7;
+            }
+            bytes.push_back(static_cast<uint8_t>(delta));
+        }
+        last = value;
+        count++;
+    }
+
+public:
+    class Cursor {
+    private:
+        const VarintSet* set;
+        size_t index;
+        size_t offset;
+        uint32_t current;
+
+        void enterBlock(size_t block) {
+            index = block * BLOCK;
+            offset = set->skips[block].offset;
+            current = set->skips[block].first;
+        }
+
+    public:
+        explicit Cursor(const VarintSet& source) : set(&source), index(0), offset(0), current(0) {
+            if (set->count > 0) enterBlock(0);
+        }
+
+        bool atEnd() const {
+            return index >= set->count;
+        }
+
+        uint32_t value() const {
+            return current;
+        }
+
+        void advance() {
+            index++;
+            if (index >= set->count) return;
+            if (index % BLOCK == 0) {
+                enterBlock(index / BLOCK);
+                return;
+            }
+
+            uint32_t delta = 0;
+            int shift = 0;
+            uint8_t byte;
+            do {
+                byte = set->bytes[offset++];
+                delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+            current += delta;
+        }
+
+        void skipTo(uint32_t target) {
+            if (atEnd() || current >= target) return;
+
+            //блоки, целиком лежащие левее target, не декодируются
+            auto begin = set->skips.begin() + index / BLOCK + 1;
+            auto it = std::upper_bound(begin, set->skips.end(), target,
+                [](uint32_t value, const Skip& skip) { return value < skip.first; });
+            if (it != begin) {
+                enterBlock(static_cast<size_t>(it - set->skips.begin()) - 1);
+            }
+
+            while (!atEnd() && current < target) {
+                advance();
+            }
+        }
+    };
+
+    static VarintSet encode(const std::vector<uint32_t>& values) {
+        VarintSet result;
+        for (uint32_t value : values) {
+            result.append(value);
+        }
+        return result;
+    }
+
+    std::vector<uint32_t> decode() const {
+        std::vector<uint32_t> values;
+        values.reserve(count);
+        for (Cursor cursor(*this); !cursor.atEnd(); cursor.advance()) {
+            values.push_back(cursor.value());
+        }
+        return values;
+    }
+
+    size_t getSize() const {
+        return count;
+    }
+
+    size_t memoryUsage() const {
+        return sizeof(VarintSet) + bytes.capacity() + skips.capacity() * sizeof(Skip);
+    }
+
+    static VarintSet unionSets(const VarintSet& setA, const VarintSet& setB) {
+        VarintSet result;
+        mergeUnion(Cursor(setA), Cursor(setB), [&](uint32_t value) { result.append(value); });
+        return result;
+    }
+
+    static VarintSet intersection(const VarintSet& setA, const VarintSet& setB) {
+        VarintSet result;
+        mergeIntersection(Cursor(setA), Cursor(setB), [&](uint32_t value) { result.append(value); });
+        return result;
+    }
+
+    static VarintSet difference(const VarintSet& setA, const VarintSet& setB) {
+        VarintSet result;
+        mergeDifference(Cursor(setA), Cursor(setB), [&](uint32_t value) { result.append(value); });
+        return result;
+    }
+
+    static bool isSubset(const VarintSet& setA, const VarintSet& setB) {
+        return setA.count <= setB.count && mergeIsSubset(Cursor(setA), Cursor(setB));
+    }
+
+    static bool areEqual(const VarintSet& setA, const VarintSet& setB) {
+        return setA.count == setB.count && mergeIsSubset(Cursor(setA), Cursor(setB));
+    }
+};
+
+//кодирование Элиаса–Фано: младшие lowBits битов значений упакованы подряд,
+//старшие части записаны в унарном виде; каждый SKIP-й ноль старшей части запомнен
+class EliasFanoSet {
+private:
+    static const size_t SKIP = 64;
+
+    size_t count = 0;
+    uint64_t universe = 0;   //max + 1; для max = UINT32_MAX не помещается в 32 бита
+    int lowBits = 0;
+    std::vector<uint64_t> low;
+    std::vector<uint64_t> high;
+    std::vector<size_t> zeroSamples;   //zeroSamples[j] – позиция (j * SKIP)-го нуля в high
+
+    uint32_t lowPart(size_t i) const {
+        if (lowBits == 0) return 0;
+        size_t bit = i * lowBits;
+        size_t w = bit >> 6;
+        int shift = static_cast<int>(bit & 63);
+        uint64_t value = low[w] >> shift;
+        if (shift + lowBits > 64) {
+            value |= low[w + 1] << (64 - shift);
+        }
+        return static_cast<uint32_t>(value & ((uint64_t(1) << lowBits) - 1));
+    }
+
+    //первая единица в high, начиная с позиции pos
+    size_t nextOne(size_t pos) const {
+        size_t w = pos >> 6;
+        uint64_t word = high[w] & (~uint64_t(0) << (pos & 63));
+        while (word == 0) {
+            word = high[++w];
+        }
+        return w * 64 + lowestBit(word);
+    }
+
+    //позиция k-го нуля в high (с нуля)
+    size_t selectZero(size_t k) const {
+        size_t pos = zeroSamples[k / SKIP];
+        size_t remaining = k % SKIP;
+        if (remaining == 0) return pos;
+
+        pos++;
+        size_t w = pos >> 6;
+        uint64_t word = ~high[w] & (~uint64_t(0) << (pos & 63));
+        while (true) {
+            size_t zeros = popCount(word);
+            if (remaining <= zeros) {
+                for (size_t i = 1; i < remaining; i++) {
+                    word &= word - 1;
+                }
+                return w * 64 + lowestBit(word);
+            }
+            remaining -= zeros;
+            word = ~high[++w];
+        }
+    }
+
+public:
+    class Cursor {
+    private:
+        const EliasFanoSet* set;
+        size_t index;
+        size_t position;   //позиция единицы текущего элемента в high
+
+        void load() {
+            if (index < set->count) position = set->nextOne(position);
+        }
+
+    public:
+        explicit Cursor(const EliasFanoSet& source) : set(&source), index(0), position(0) {
+            load();
+        }
+
+        bool atEnd() const {
+            return index >= set->count;
+        }
+
+        uint32_t value() const {
+            return static_cast<uint32_t>(((position - index) << set->lowBits) | set->lowPart(index));
+        }
+
+        void advance() {
+            index++;
+            position++;
+            load();
+        }
+
+        void skipTo(uint32_t target) {
+            if (atEnd() || value() >= target) return;
+
+            //сразу переходим к началу корзины старших битов target
+            size_t bucket = static_cast<size_t>(uint64_t(target) >> set->lowBits);
+            if (bucket > ((set->universe - 1) >> set->lowBits)) {
+                index = set->count;
+                return;
+            }
+            if (bucket > position - index) {
+                position = set->selectZero(bucket - 1) + 1;
+                index = position - bucket;
+                load();
+            }
+
+            while (!atEnd() && value() < target) {
+                advance();
+            }
+        }
+    };
+
+    static EliasFanoSet encode(const std::vector<uint32_t>& values) {
+        EliasFanoSet result;
+        for (size_t i = 1; i < values.size(); i++) {
+            if (values[i] <= values[i - 1]) {
+                throw std::invalid_argument("Values must be strictly increasing");
+            }
+        }
+
+        result.count = values.size();
+        if (result.count == 0) return result;
+
+        result.universe = uint64_t(values.back()) + 1;
+        if (result.universe > result.count) {
+            result.lowBits = highestBit(result.universe / result.count);
+        }
+
+        size_t highBits = result.count + (static_cast<size_t>(result.universe - 1) >> result.lowBits) + 1;
+        result.low.assign((result.count * result.lowBits + 63) / 64 + 1, 0);
+        result.high.assign(highBits / 64 + 2, 0);
+
+        for (size_t i = 0; i < result.count; i++) {
+            if (result.lowBits > 0) {
+                uint64_t part = values[i] & ((uint64_t(1) << result.lowBits) - 1);
+                size_t bit = i * result.lowBits;
+                result.low[bit >> 6] |= part << (bit & 63);
+                if ((bit & 63) + result.lowBits > 64) {
+                    result.low[(bit >> 6) + 1] |= part >> (64 - (bit & 63));
+                }
+            }
+            size_t pos = static_cast<size_t>(uint64_t(values[i]) >> result.lowBits) + i;
+            result.high[pos >> 6] |= uint64_t(1) << (pos & 63);
+        }
+
+        size_t zeros = 0;
+        for (size_t pos = 0; pos < highBits; pos++) {
+            if ((result.high[pos >> 6] >> (pos & 63)) & 1) continue;
+            if (zeros % SKIP == 0) result.zeroSamples.push_back(pos);
+            zeros++;
+        }
+        return result;
+    }
+
+    std::vector<uint32_t> decode() const {
+        std::vector<uint32_t> values;
+        values.reserve(count);
+        for (Cursor cursor(*this); !cursor.atEnd(); cursor.advance()) {
+            values.push_back(cursor.value());
+        }
+        return values;
+    }
+
+    size_t getSize() const {
+        return count;
+    }
+
+    size_t memoryUsage() const {
+        return sizeof(EliasFanoSet) + (low.capacity() + high.capacity()) * sizeof(uint64_t)
+            + zeroSamples.capacity() * sizeof(size_t);
+    }
+
+    static EliasFanoSet unionSets(const EliasFanoSet& setA, const EliasFanoSet& setB) {
+        std::vector<uint32_t> values;
+        mergeUnion(Cursor(setA), Cursor(setB), [&](uint32_t value) { values.push_back(value); });
+        return encode(values);
+    }
+
+    static EliasFanoSet intersection(const EliasFanoSet& setA, const EliasFanoSet& setB) {
+        std::vector<uint32_t> values;
+        mergeIntersection(Cursor(setA), Cursor(setB), [&](uint32_t value) { values.push_back(value); });
+        return encode(values);
+    }
+
+    static EliasFanoSet difference(const EliasFanoSet& setA, const EliasFanoSet& setB) {
+        std::vector<uint32_t> values;
+        mergeDifference(Cursor(setA), Cursor(setB), [&](uint32_t value) { values.push_back(value); });
+        return encode(values);
+    }
+
+    static bool isSubset(const EliasFanoSet& setA, const EliasFanoSet& setB) {
+        return setA.count <= setB.count && mergeIsSubset(Cursor(setA), Cursor(setB));
+    }
+
+    static bool areEqual(const EliasFanoSet& setA, const EliasFanoSet& setB) {
+        return setA.count == setB.count && mergeIsSubset(Cursor(setA), Cursor(setB));
+    }
+};
+
+//пул потоков на всё время работы программы: задачи 0..count-1 делятся на диапазоны
+//потоков, каждый поток берёт задачи из своего диапазона, а освободившись, забирает
+//половину оставшихся у другого потока. Поток, вызвавший run, работает наравне с пулом
+class WorkPool {
+private:
+    struct Range {
+        std::mutex lock;
+        size_t next = 0;
+        size_t end = 0;
+    };
+
+    std::vector<Range> ranges;
+    std::vector<std::thread> workers;
+    //одна задача за раз: повторный вызов из другого потока ждёт её завершения
+    std::mutex submit;
+    std::mutex mutex;
+    std::condition_variable started;
+    std::condition_variable finished;
+    const std::function<void(size_t)>* body = nullptr;
+    size_t count = 0;
+    uint64_t generation = 0;
+    unsigned active = 0;
+    bool stopping = false;
+
+    //true в потоках пула и в потоке, выполняющем run: вложенный вызов идёт последовательно
+    static bool& insidePool() {
+        static thread_local bool inside = false;
+        return inside;
+    }
+
+    void runRanges(unsigned self, const std::function<void(size_t)>& task, size_t tasks) {
+        unsigned threads = static_cast<unsigned>(ranges.size());
+        while (true) {
+            size_t next = tasks;
+            {
+                std::lock_guard<std::mutex> guard(ranges[self].lock);
+                if (ranges[self].next < ranges[self].end) next = ranges[self].next++;
+            }
+            if (next < tasks) {
+                task(next);
+                continue;
+            }
+
+            bool stolen = false;
+            for (unsigned k = 1; k < threads && !stolen; k++) {
+                Range& victim = ranges[(self + k) % threads];
+                size_t from, to;
+                {
+                    std::lock_guard<std::mutex> guard(victim.lock);
+                    size_t left = victim.end - victim.next;
+                    if (left == 0) continue;
+                    to = victim.end;
+                    from = victim.end = to - (left + 1) / 2;
+                }
+                std::lock_guard<std::mutex> guard(ranges[self].lock);
+                ranges[self].next = from;
+                ranges[self].end = to;
+                stolen = true;
+            }
+            if (!stolen) return;
+        }
+    }
+
+    void workerLoop(unsigned self) {
+        insidePool() = true;
+        uint64_t seen = 0;
+        while (true) {
+            const std::function<void(size_t)>* task;
+            size_t tasks;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                started.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                task = body;
+                tasks = count;
+            }
+            runRanges(self, *task, tasks);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--active == 0) finished.notify_one();
+        }
+    }
+
+public:
+    //threads – число потоков вместе с вызывающим, пул запускает threads - 1 потоков
+    explicit WorkPool(unsigned threads) : ranges(std::max(1u, threads)) {
+        for (unsigned t = 1; t < ranges.size(); t++) {
+            workers.emplace_back(&WorkPool::workerLoop, this, t);
+        }
+    }
+
+    ~WorkPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        started.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    WorkPool(const WorkPool&) = delete;
+    WorkPool& operator=(const WorkPool&) = delete;
+
+    //общий пул по числу ядер, потоки создаются при первом обращении
+    static WorkPool& instance() {
+        static WorkPool pool(std::thread::hardware_concurrency());
+        return pool;
+    }
+
+    unsigned getThreads() const {
+        return static_cast<unsigned>(ranges.size());
+    }
+
+    template <typename Body>
+    void run(size_t tasks, Body taskBody) {
+        if (workers.empty() || tasks <= 1 || insidePool()) {
+            for (size_t task = 0; task < tasks; task++) {
+                taskBody(task);
+            }
+            return;
+        }
+
+        std::function<void(size_t)> task(taskBody);
+        std::lock_guard<std::mutex> exclusive(submit);
+        unsigned threads = getThreads();
+        for (unsigned t = 0; t < threads; t++) {
+            ranges[t].next = tasks * t / threads;
+            ranges[t].end = tasks * (t + 1) / threads;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            body = &task;
+            count = tasks;
+            active = static_cast<unsigned>(workers.size());
+            generation++;
+        }
+        started.notify_all();
+
+        insidePool() = true;
+        runRanges(0, task, tasks);
+        insidePool() = false;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return active == 0; });
+    }
+};
+
+template <typename Body>
+void parallelFor(size_t count, Body body) {
+    WorkPool::instance().run(count, body);
+}
+
+//поиск совпадений в блоках отсортированных массивов: бит k маски – a[k] равен
+//какому-либо элементу блока b. 8- и 16-битные блоки сравнивает одна инструкция
+//SSE4.2 (pcmpestrm), 32- и 64-битные – сравнения со всеми циклическими сдвигами блока b
+#ifdef SET_BATCH_X86
+#if defined(_MSC_VER)
+#define SET_FLATTEN
+#else
+#define SET_FLATTEN __attribute__((flatten))
+#endif
+
+struct MatchSse8 {
+    typedef uint8_t Value;
+    static const size_t WIDTH = 16;
+    SET_TARGET_SSE42 static uint32_t mask(const uint8_t* a, const uint8_t* b) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(
+            _mm_cmpestrm(vb, 16, va, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK)));
+    }
+};
+
+struct MatchSse16 {
+    typedef uint16_t Value;
+    static const size_t WIDTH = 8;
+    SET_TARGET_SSE42 static uint32_t mask(const uint16_t* a, const uint16_t* b) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(
+            _mm_cmpestrm(vb, 8, va, 8, _SIDD_UWORD_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK)));
+    }
+};
+
+struct MatchSse32 {
+    typedef uint32_t Value;
+    static const size_t WIDTH = 4;
+    SET_TARGET_SSE42 static uint32_t mask(const uint32_t* a, const uint32_t* b) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+        __m128i equal = _mm_cmpeq_epi32(va, vb);
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1))));
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3))));
+        return static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(equal)));
+    }
+};
+
+struct MatchSse64 {
+    typedef uint64_t Value;
+    static const size_t WIDTH = 2;
+    SET_TARGET_SSE42 static uint32_t mask(const uint64_t* a, const uint64_t* b) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+        __m128i equal = _mm_or_si128(_mm_cmpeq_epi64(va, vb),
+            _mm_cmpeq_epi64(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+        return static_cast<uint32_t>(_mm_movemask_pd(_mm_castsi128_pd(equal)));
+    }
+};
+
+struct MatchAvx2x32 {
+    typedef uint32_t Value;
+    static const size_t WIDTH = 8;
+    SET_TARGET_AVX2 static uint32_t mask(const uint32_t* a, const uint32_t* b) {
+        const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+        __m256i equal = _mm256_cmpeq_epi32(va, vb);
+        for (int r = 1; r < 8; r++) {
+            vb = _mm256_permutevar8x32_epi32(vb, rotate);
+            equal = _mm256_or_si256(equal, _mm256_cmpeq_epi32(va, vb));
+        }
+        return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(equal)));
+    }
+};
+
+struct MatchAvx2x64 {
+    typedef uint64_t Value;
+    static const size_t WIDTH = 4;
+    SET_TARGET_AVX2 static uint32_t mask(const uint64_t* a, const uint64_t* b) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+        __m256i equal = _mm256_cmpeq_epi64(va, vb);
+        for (int r = 1; r < 4; r++) {
+            vb = _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(0, 3, 2, 1));
+            equal = _mm256_or_si256(equal, _mm256_cmpeq_epi64(va, vb));
+        }
+        return static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(equal)));
+    }
+};
+
+//блочное слияние: блоки a и b по WIDTH элементов сравниваются целиком, затем сдвигается
+//блок с меньшим последним элементом. Совпадения блока a копятся, пока он не будет пройден,
+//и тогда выводятся совпавшие (пересечение) или несовпавшие (разность) элементы
+template <typename Match, bool KeepMatched>
+inline size_t blockMerge(const typename Match::Value* a, size_t na, const typename Match::Value* b, size_t nb,
+    typename Match::Value* out) {
+    const size_t width = Match::WIDTH;
+    const uint32_t all = static_cast<uint32_t>((uint64_t(1) << width) - 1);
+    size_t i = 0, j = 0, n = 0;
+    uint32_t matched = 0;
+
+    while (i + width <= na && j + width <= nb) {
+        matched |= Match::mask(a + i, b + j);
+        typename Match::Value lastA = a[i + width - 1];
+        typename Match::Value lastB = b[j + width - 1];
+        if (lastA <= lastB) {
+            uint32_t keep = KeepMatched ? matched : ~matched & all;
+            if (out == nullptr) {
+                n += popCount(keep);
+            }
+            else {
+                for (; keep != 0; keep &= keep - 1) {
+                    out[n++] = a[i + lowestBit(keep)];
+                }
+            }
+            i += width;
+            matched = 0;
+        }
+        if (lastB <= lastA) {
+            j += width;
+        }
+    }
+
+    //хвост: совпадения незаконченного блока a уже в matched, остальное – обычным слиянием
+    for (size_t k = 0; i < na; i++, k++) {
+        while (j < nb && b[j] < a[i]) j++;
+        bool found = (k < width && ((matched >> k) & 1)) || (j < nb && b[j] == a[i]);
+        if (found == KeepMatched) {
+            if (out) out[n] = a[i];
+            n++;
+        }
+    }
+    return n;
+}
+
+template <typename Match, bool KeepMatched>
+SET_TARGET_SSE42 SET_FLATTEN size_t blockMergeSse42(const typename Match::Value* a, size_t na,
+    const typename Match::Value* b, size_t nb, typename Match::Value* out) {
+    return blockMerge<Match, KeepMatched>(a, na, b, nb, out);
+}
+
+template <typename Match, bool KeepMatched>
+SET_TARGET_AVX2 SET_FLATTEN size_t blockMergeAvx2(const typename Match::Value* a, size_t na,
+    const typename Match::Value* b, size_t nb, typename Match::Value* out) {
+    return blockMerge<Match, KeepMatched>(a, na, b, nb, out);
+}
+
+//векторные блоки для каждого размера элемента; void – расширения нет
+template <typename T> struct SimdMatch;
+template <> struct SimdMatch<uint8_t> { typedef MatchSse8 Sse42; typedef void Avx2; };
+template <> struct SimdMatch<uint16_t> { typedef MatchSse16 Sse42; typedef void Avx2; };
+template <> struct SimdMatch<uint32_t> { typedef MatchSse32 Sse42; typedef MatchAvx2x32 Avx2; };
+template <> struct SimdMatch<uint64_t> { typedef MatchSse64 Sse42; typedef MatchAvx2x64 Avx2; };
+#endif
+
+//ядра слияния отсортированных массивов без повторов (8-, 16-, 32- и 64-битные элементы);
+//при out == nullptr ядра только считают размер результата.
+//Ядро выбирается по размерам входов: если один вход больше другого в GALLOP_RATIO раз,
+//элементы меньшего ищутся в большем галопом (экспоненциальным поиском); иначе 8- и 16-битные
+//пересечение и разность идут блоками векторных сравнений, если процессор их поддерживает,
+//а 32- и 64-битные – обычным слиянием: по замерам bench блоки из сравнений со сдвигами
+//не быстрее обычного слияния для пересечения и медленнее для разности
+template <typename T>
+class SortedKernels {
+public:
+    typedef size_t (*Kernel)(const T* a, size_t na, const T* b, size_t nb, T* out);
+
+    static const size_t GALLOP_RATIO = 32;
+    //блочные ядра выигрывают у обычного слияния только для 8- и 16-битных элементов
+    static const bool USE_BLOCKS = sizeof(T) <= 2;
+
+    struct BlockKernels {
+        Kernel intersection;
+        Kernel difference;
+        const char* name;
+    };
+
+private:
+    //первая позиция с v[pos] >= value, начиная с from: шаги 1, 2, 4, ..., затем двоичный поиск
+    static size_t gallop(const T* v, size_t from, size_t n, T value) {
+        size_t step = 1;
+        size_t hi = from;
+        while (hi < n && v[hi] < value) {
+            from = hi + 1;
+            hi += step;
+            step *= 2;
+        }
+        return std::lower_bound(v + from, v + std::min(hi, n), value) - v;
+    }
+
+    static size_t copy(const T* from, size_t count, T* out, size_t n) {
+        if (out) std::copy(from, from + count, out + n);
+        return count;
+    }
+
+    static BlockKernels selectBlockKernels() {
+#ifdef SET_BATCH_X86
+        typedef typename SimdMatch<T>::Avx2 Avx2;
+        typedef typename SimdMatch<T>::Sse42 Sse42;
+        if constexpr (!std::is_void<Avx2>::value) {
+            if (cpuHasAvx2()) {
+                return BlockKernels{ blockMergeAvx2<Avx2, true>, blockMergeAvx2<Avx2, false>, "avx2" };
+            }
+        }
+        if (cpuHasSse42()) {
+            return BlockKernels{ blockMergeSse42<Sse42, true>, blockMergeSse42<Sse42, false>, "sse4.2" };
+        }
+#endif
+        return BlockKernels{ scalarIntersection, scalarDifference, "scalar" };
+    }
+
+public:
+    static bool skewed(size_t na, size_t nb) {
+        return std::min(na, nb) * GALLOP_RATIO < std::max(na, nb);
+    }
+
+    static size_t scalarUnion(const T* a, size_t na, const T* b, size_t nb, T* out) {
+        size_t i = 0, j = 0, n = 0;
+        while (i < na && j < nb) {
+            T value = a[i] < b[j] ? a[i++] : b[j] < a[i] ? b[j++] : (j++, a[i++]);
+            if (out) out[n] = value;
+            n++;
+        }
+        n += copy(a + i, na - i, out, n);
+        n += copy(b + j, nb - j, out, n);
+        return n;
+    }
+
+    static size_t scalarIntersection(const T* a, size_t na, const T* b, size_t nb, T* out) {
+        size_t i = 0, j = 0, n = 0;
+        while (i < na && j < nb) {
+            if (a[i] < b[j]) {
+                i++;
+            }
+            else if (b[j] < a[i]) {
+                j++;
+            }
+            else {
+                if (out) out[n] = a[i];
+                n++;
+                i++;
+                j++;
+            }
+        }
+        return n;
+    }
+
+    static size_t scalarDifference(const T* a, size_t na, const T* b, size_t nb, T* out) {
+        size_t i = 0, j = 0, n = 0;
+        while (i < na) {
+            while (j < nb && b[j] < a[i]) j++;
+            if (j == nb || b[j] != a[i]) {
+                if (out) out[n] = a[i];
+                n++;
+            }
+            i++;
+        }
+        return n;
+    }
+
+    //отрезки большего входа между элементами меньшего копируются целиком
+    static size_t gallopUnion(const T* a, size_t na, const T* b, size_t nb, T* out) {
+        if (na < nb) {
+            std::swap(a, b);
+            std::swap(na, nb);
+        }
+        size_t i = 0, n = 0;
+        for (size_t j = 0; j < nb; j++) {
+            size_t next = gallop(a, i, na, b[j]);
+            n += copy(a + i, next - i, out, n);
+            if (out) out[n] = b[j];
+            n++;
+            i = next < na && a[next] == b[j] ? next + 1 : next;
+        }
+        n += copy(a + i, na - i, out, n);
+        return n;
+    }
+
+    static size_t gallopIntersection(const T* a, size_t na, const T* b, size_t nb, T* out) {
+        if (na > nb) {
+            std::swap(a, b);
+            std::swap(na, nb);
+        }
+        size_t j = 0, n = 0;
+        for (size_t i = 0; i < na && j < nb; i++) {
+            j = gallop(b, j, nb, a[i]);
+            if (j < nb && b[j] == a[i]) {
+                if (out) out[n] = a[i];
+                n++;
+            }
+        }
+        return n;
+    }
+
+    static size_t gallopDifference(const T* a, size_t na, const T* b, size_t nb, T* out) {
+        size_t i = 0, j = 0, n = 0;
+        if (na <= nb) {
+            for (; i < na; i++) {
+                j = gallop(b, j, nb, a[i]);
+                if (j == nb || b[j] != a[i]) {
+                    if (out) out[n] = a[i];
+                    n++;
+                }
+            }
+            return n;
+        }
+        for (; j < nb && i < na; j++) {
+            size_t next = gallop(a, i, na, b[j]);
+            n += copy(a + i, next - i, out, n);
+            i = next < na && a[next] == b[j] ? next + 1 : next;
+        }
+        n += copy(a + i, na - i, out, n);
+        return n;
+    }
+
+    //векторные ядра выбираются один раз по возможностям процессора
+    static const BlockKernels& blockKernels() {
+        static const BlockKernels kernels = selectBlockKernels();
+        return kernels;
+    }
+
+    static size_t unionOf(const T* a, size_t na, const T* b, size_t nb, T* out) {
+        return skewed(na, nb) ? gallopUnion(a, na, b, nb, out) : scalarUnion(a, na, b, nb, out);
+    }
+
+    static size_t intersection(const T* a, size_t na, const T* b, size_t nb, T* out) {
+        if (skewed(na, nb)) return gallopIntersection(a, na, b, nb, out);
+        return USE_BLOCKS ? blockKernels().intersection(a, na, b, nb, out) : scalarIntersection(a, na, b, nb, out);
+    }
+
+    static size_t difference(const T* a, size_t na, const T* b, size_t nb, T* out) {
+        if (skewed(na, nb)) return gallopDifference(a, na, b, nb, out);
+        return USE_BLOCKS ? blockKernels().difference(a, na, b, nb, out) : scalarDifference(a, na, b, nb, out);
+    }
+};
+
+//множество целых в отсортированном непрерывном массиве; бинарные операции над
+//большими множествами делят диапазон значений на части и сливают их параллельно
+class SortedSet {
+public:
+    //суммарный размер входов, начиная с которого слияние выполняется параллельно
+    static const size_t PARALLEL_THRESHOLD = size_t(1) << 20;
+    //частей на поток: запас для перехвата работы при неравномерных данных
+    static const size_t PARTS_PER_THREAD = 4;
+
+private:
+    std::vector<uint32_t> values;
+
+    //границы частей: в части p лежат значения [split[p], split[p + 1]) обоих входов
+    struct Split {
+        size_t a;
+        size_t b;
+    };
+
+    //делители подбираются по позиции в слитой последовательности (merge path),
+    //затем граница сдвигается к началу серии равных значений в обоих входах
+    static std::vector<Split> partition(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, size_t parts) {
+        std::vector<Split> splits(parts + 1);
+        size_t total = a.size() + b.size();
+        splits[0] = Split{ 0, 0 };
+        splits[parts] = Split{ a.size(), b.size() };
+
+        for (size_t p = 1; p < parts; p++) {
+            size_t k = total * p / parts;
+            size_t lo = k > b.size() ? k - b.size() : 0;
+            size_t hi = std::min(k, a.size());
+            while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+                if (a[mid] < b[k - mid - 1]) lo = mid + 1;
+                else hi = mid;
+            }
+
+            size_t i = lo;
+            size_t j = k - lo;
+            if (i == a.size() && j == b.size()) {
+                splits[p] = splits[parts];
+                continue;
+            }
+            uint32_t pivot = (j == b.size() || (i < a.size() && a[i] <= b[j])) ? a[i] : b[j];
+            splits[p].a = std::lower_bound(a.begin(), a.end(), pivot) - a.begin();
+            splits[p].b = std::lower_bound(b.begin(), b.end(), pivot) - b.begin();
+        }
+        return splits;
+    }
+
+    //до порога – одно слияние; выше – подсчёт размеров частей, затем каждая часть
+    //пишет результат прямо в своё место общего массива, без последующей склейки
+    template <typename Kernel>
+    static SortedSet run(const SortedSet& setA, const SortedSet& setB, Kernel kernel) {
+        const std::vector<uint32_t>& a = setA.values;
+        const std::vector<uint32_t>& b = setB.values;
+        SortedSet result;
+
+        if (a.size() + b.size() < PARALLEL_THRESHOLD) {
+            result.values.resize(kernel(a.data(), a.size(), b.data(), b.size(), nullptr));
+            kernel(a.data(), a.size(), b.data(), b.size(), result.values.data());
+            return result;
+        }
+
+        size_t parts = WorkPool::instance().getThreads() * PARTS_PER_THREAD;
+        std::vector<Split> splits = partition(a, b, parts);
+        std::vector<size_t> offsets(parts + 1, 0);
+
+        parallelFor(parts, [&](size_t p) {
+            offsets[p + 1] = kernel(a.data() + splits[p].a, splits[p + 1].a - splits[p].a,
+                b.data() + splits[p].b, splits[p + 1].b - splits[p].b, nullptr);
+        });
+        for (size_t p = 0; p < parts; p++) {
+            offsets[p + 1] += offsets[p];
+        }
+
+        result.values.resize(offsets[parts]);
+        parallelFor(parts, [&](size_t p) {
+            kernel(a.data() + splits[p].a, splits[p + 1].a - splits[p].a,
+                b.data() + splits[p].b, splits[p + 1].b - splits[p].b, result.values.data() + offsets[p]);
+        });
+        return result;
+    }
+
+public:
+    SortedSet() {}
+
+    //значения сортируются, повторы удаляются
+    explicit SortedSet(std::vector<uint32_t> elements) : values(std::move(elements)) {
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+    }
+
+    const std::vector<uint32_t>& getValues() const {
+        return values;
+    }
+
+    size_t getSize() const {
+        return values.size();
+    }
+
+    bool contains(uint32_t value) const {
+        return std::binary_search(values.begin(), values.end(), value);
+    }
+
+    static SortedSet unionSets(const SortedSet& setA, const SortedSet& setB) {
+        return run(setA, setB, SortedKernels<uint32_t>::unionOf);
+    }
+
+    static SortedSet intersection(const SortedSet& setA, const SortedSet& setB) {
+        return run(setA, setB, SortedKernels<uint32_t>::intersection);
+    }
+
+    static SortedSet difference(const SortedSet& setA, const SortedSet& setB) {
+        return run(setA, setB, SortedKernels<uint32_t>::difference);
+    }
+
+    static bool isSubset(const SortedSet& setA, const SortedSet& setB) {
+        if (setA.values.size() > setB.values.size()) return false;
+        return difference(setA, setB).values.empty();
+    }
+
+    static bool areEqual(const SortedSet& setA, const SortedSet& setB) {
+        return setA.values == setB.values;
+    }
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include "set_store.h"
+
+SetHistory::SetHistory() : head(std::make_shared<const Catalog>()) {
+    versions[0] = head;
+}
+
+void SetHistory::collect() {
+    for (auto it = versions.begin(); it != versions.end();) {
+        if (it->second.expired()) it = versions.erase(it);
+        else ++it;
+    }
+}
+
+void SetHistory::commit(int slot, const Set::Bitmap* elements) {
+    const std::shared_ptr<const Set::Bitmap>& old = head->sets[slot];
+    if (elements == nullptr ? old == nullptr : old != nullptr && Set::Bitmap::areEqual(*old, *elements)) {
+        return;
+    }
+
+    std::shared_ptr<Catalog> next = std::make_shared<Catalog>(*head);
+    next->version = head->version + 1;
+    next->sets[slot] = elements == nullptr ? nullptr : std::make_shared<const Set::Bitmap>(*elements);
+    head = next;
+    versions[head->version] = head;
+    collect();
+}
+
+SetHistory::Snapshot SetHistory::find(uint64_t version) const {
+    auto it = versions.find(version);
+    return it == versions.end() ? nullptr : it->second.lock();
+}
+
+SetHistory::Snapshot SetHistory::pin() {
+    pinned[head->version] = head;
+    return head;
+}
+
+bool SetHistory::unpin(uint64_t version) {
+    bool found = pinned.erase(version) > 0;
+    collect();
+    return found;
+}
+
+const char* statusMessage(SetStatus status) {
+    switch (status) {
+    case SET_OK: return "OK";
+    case SET_INVALID_NAME: return "The name of the set must be a single character in the A-Z range";
+    case SET_INVALID_ELEMENT: return "Element must be a printable character";
+    case SET_INVALID_OPERATION: return "Unknown set operation";
+    case SET_NOT_FOUND: return "Set not found";
+    case SET_ALREADY_EXISTS: return "Set already exists";
+    case SET_VERSION_NOT_AVAILABLE: return "Version is not available";
+    }
+    return "Unknown status";
+}
+
+SetResult<Set::Bitmap> SetStore::apply(char operation, const Set::Bitmap& bitsA, const Set::Bitmap& bitsB) {
+    SetResult<Set::Bitmap> result;
+    switch (operation) {
+    case '+': result.value = Set::Bitmap::unionSets(bitsA, bitsB); break;
+    case '&': result.value = Set::Bitmap::intersection(bitsA, bitsB); break;
+    case '-': result.value = Set::Bitmap::difference(bitsA, bitsB); break;
+    default: result.status = SET_INVALID_OPERATION; break;
+    }
+    return result;
+}
+
+SetResult<bool> SetStore::test(char operation, const Set::Bitmap& bitsA, const Set::Bitmap& bitsB) {
+    SetResult<bool> result;
+    switch (operation) {
+    case '<': result.value = Set::Bitmap::isSubset(bitsA, bitsB); break;
+    case '=': result.value = Set::Bitmap::areEqual(bitsA, bitsB); break;
+    default: result.status = SET_INVALID_OPERATION; break;
+    }
+    return result;
+}
+
+SetStatus SetStore::bitsOf(char name, const Set::Bitmap*& bits) const {
+    if (!validName(name)) return SET_INVALID_NAME;
+    int index = indexOf(name);
+    if (index == -1) return SET_NOT_FOUND;
+    bits = &sets[index].getBits();
+    return SET_OK;
+}
+
+SetStatus SetStore::bitsAt(uint64_t version, char name, SetHistory::Snapshot& snapshot, const Set::Bitmap*& bits) const {
+    if (!validName(name)) return SET_INVALID_NAME;
+    if (snapshot == nullptr) snapshot = history.find(version);
+    if (snapshot == nullptr) return SET_VERSION_NOT_AVAILABLE;
+    bits = snapshot->sets[name - 'A'].get();
+    return bits == nullptr ? SET_NOT_FOUND : SET_OK;
+}
+
+int SetStore::indexOf(char name) const {
+    for (size_t i = 0; i < sets.size(); i++) {
+        if (sets[i].getName()[0] == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+SetStatus SetStore::createSet(char name) {
+    if (!validName(name)) return SET_INVALID_NAME;
+    if (indexOf(name) != -1) return SET_ALREADY_EXISTS;
+    sets.push_back(Set(std::string(1, name)));
+    history.commit(name - 'A', &sets.back().getBits());
+    return SET_OK;
+}
+
+SetStatus SetStore::deleteSet(char name) {
+    if (!validName(name)) return SET_INVALID_NAME;
+    int index = indexOf(name);
+    if (index == -1) return SET_NOT_FOUND;
+    sets.erase(sets.begin() + index);
+    history.commit(name - 'A', nullptr);
+    return SET_OK;
+}
+
+SetStatus SetStore::addElement(char name, char element) {
+    if (!validName(name)) return SET_INVALID_NAME;
+    if (!Set::isElement(element)) return SET_INVALID_ELEMENT;
+    int index = indexOf(name);
+    if (index == -1) return SET_NOT_FOUND;
+    sets[index].addElement(element);
+    history.commit(name - 'A', &sets[index].getBits());
+    return SET_OK;
+}
+
+SetStatus SetStore::removeElement(char name, char element) {
+    if (!validName(name)) return SET_INVALID_NAME;
+    int index = indexOf(name);
+    if (index == -1) return SET_NOT_FOUND;
+    sets[index].removeElement(element);
+    history.commit(name - 'A', &sets[index].getBits());
+    return SET_OK;
+}
+
+SetResult<bool> SetStore::contains(char name, char element) const {
+    SetResult<bool> result;
+    const Set::Bitmap* bits = nullptr;
+    result.status = bitsOf(name, bits);
+    if (result.ok()) result.value = Set::isElement(element) && bits->contains(element);
+    return result;
+}
+
+SetStatus SetStore::containsBatch(char name, const char* elements, size_t count, uint64_t* mask) const {
+    if (!validName(name)) return SET_INVALID_NAME;
+    int index = indexOf(name);
+    if (index == -1) return SET_NOT_FOUND;
+    sets[index].containsBatch(elements, count, mask);
+    return SET_OK;
+}
+
+SetResult<Set::Bitmap> SetStore::getElements(char name) const {
+    SetResult<Set::Bitmap> result;
+    const Set::Bitmap* bits = nullptr;
+    result.status = bitsOf(name, bits);
+    if (result.ok()) result.value = *bits;
+    return result;
+}
+
+SetResult<Set::Bitmap> SetStore::combine(char operation, char nameA, char nameB) const {
+    SetResult<Set::Bitmap> result;
+    const Set::Bitmap* bitsA = nullptr;
+    const Set::Bitmap* bitsB = nullptr;
+    if ((result.status = bitsOf(nameA, bitsA)) != SET_OK) return result;
+    if ((result.status = bitsOf(nameB, bitsB)) != SET_OK) return result;
+    return apply(operation, *bitsA, *bitsB);
+}
+
+SetResult<bool> SetStore::compare(char operation, char nameA, char nameB) const {
+    SetResult<bool> result;
+    const Set::Bitmap* bitsA = nullptr;
+    const Set::Bitmap* bitsB = nullptr;
+    if ((result.status = bitsOf(nameA, bitsA)) != SET_OK) return result;
+    if ((result.status = bitsOf(nameB, bitsB)) != SET_OK) return result;
+    return test(operation, *bitsA, *bitsB);
+}
+
+SetResult<uint64_t> SetStore::snapshot() {
+    SetResult<uint64_t> result;
+    result.value = history.pin()->version;
+    return result;
+}
+
+SetStatus SetStore::release(uint64_t version) {
+    return history.unpin(version) ? SET_OK : SET_VERSION_NOT_AVAILABLE;
+}
+
+SetResult<Set::Bitmap> SetStore::getElementsAt(char name, uint64_t version) const {
+    SetResult<Set::Bitmap> result;
+    SetHistory::Snapshot snapshot;
+    const Set::Bitmap* bits = nullptr;
+    result.status = bitsAt(version, name, snapshot, bits);
+    if (result.ok()) result.value = *bits;
+    return result;
+}
+
+SetResult<Set::Bitmap> SetStore::combineAt(char operation, char nameA, char nameB, uint64_t version) const {
+    SetResult<Set::Bitmap> result;
+    SetHistory::Snapshot snapshot;
+    const Set::Bitmap* bitsA = nullptr;
+    const Set::Bitmap* bitsB = nullptr;
+    if ((result.status = bitsAt(version, nameA, snapshot, bitsA)) != SET_OK) return result;
+    if ((result.status = bitsAt(version, nameB, snapshot, bitsB)) != SET_OK) return result;
+    return apply(operation, *bitsA, *bitsB);
+}
+
+SetResult<bool> SetStore::compareAt(char operation, char nameA, char nameB, uint64_t version) const {
+    SetResult<bool> result;
+    SetHistory::Snapshot snapshot;
+    const Set::Bitmap* bitsA = nullptr;
+    const Set::Bitmap* bitsB = nullptr;
+    if ((result.status = bitsAt(version, nameA, snapshot, bitsA)) != SET_OK) return result;
+    if ((result.status = bitsAt(version, nameB, snapshot, bitsB)) != SET_OK) return result;
+    return test(operation, *bitsA, *bitsB);
+}
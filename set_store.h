@@ -0,0 +1,1157 @@
+#ifndef SET_STORE_H
+#define SET_STORE_H
+
+//ядро множеств A-Z: битовые множества StaticSet, пакетные ядра принадлежности, трассировка,
+//класс Set, версии для снимков и встраиваемое API SetStore. Собирается статической
+//библиотекой set_store (см. CMakeLists.txt); командный интерфейс – в dis_m1_upd.cpp
+
+#include <iostream>
+#include <climits>
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <random>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <map>
+
+//побитовые операции над 64-битными словами
+constexpr int popCount(uint64_t x) {
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return static_cast<int>((x * 0x0101010101010101ULL) >> 56);
+}
+
+constexpr int lowestBit(uint64_t x) {
+    return popCount((x & (~x + 1)) - 1);
+}
+
+constexpr int highestBit(uint64_t x) {
+    x |= x >> 1;
+    x |= x >> 2;
+    x |= x >> 4;
+    x |= x >> 8;
+    x |= x >> 16;
+    x |= x >> 32;
+    return popCount(x) - 1;
+}
+
+//множество над универсумом, известным на этапе компиляции (64, 128 или 256 элементов);
+//все операции – пословные, без ветвлений по элементам, и доступны в constexpr.
+//Элементы командной строки (символы 32..126) помещаются только в универсумы 128 и 256
+template <int Bits>
+class StaticSet {
+    static_assert(Bits == 64 || Bits == 128 || Bits == 256, "StaticSet supports 64-, 128- and 256-element universes");
+
+public:
+    static const int WORDS = Bits / 64;
+
+private:
+    uint64_t words[WORDS];
+
+    //throw не может выполниться при вычислении на этапе компиляции, поэтому там выход за
+    //универсум не компилируется, а во время выполнения – исключение, как в Set::addElement
+    static constexpr void checkElement(int element) {
+        if (element < 0 || element >= Bits) {
+            throw std::invalid_argument("Element is outside the universe of the set");
+        }
+    }
+
+public:
+    constexpr StaticSet() : words{} {}
+
+    //множество из символов строки: StaticSet<128>::of("aceg"); символ вне универсума –
+    //ошибка компиляции в constexpr и исключение во время выполнения
+    static constexpr StaticSet of(const char* elements) {
+        StaticSet result;
+        for (int i = 0; elements[i] != '\0'; i++) {
+            result.insert(static_cast<unsigned char>(elements[i]));
+        }
+        return result;
+    }
+
+    constexpr uint64_t word(int w) const {
+        return words[w];
+    }
+
+    static constexpr StaticSet fromWords(const uint64_t* source) {
+        StaticSet result;
+        for (int w = 0; w < WORDS; w++) {
+            result.words[w] = source[w];
+        }
+        return result;
+    }
+
+    constexpr bool contains(int element) const {
+        return element >= 0 && element < Bits && ((words[element >> 6] >> (element & 63)) & 1);
+    }
+
+    constexpr void insert(int element) {
+        checkElement(element);
+        words[element >> 6] |= uint64_t(1) << (element & 63);
+    }
+
+    constexpr void erase(int element) {
+        checkElement(element);
+        words[element >> 6] &= ~(uint64_t(1) << (element & 63));
+    }
+
+    constexpr int size() const {
+        int count = 0;
+        for (int w = 0; w < WORDS; w++) {
+            count += popCount(words[w]);
+        }
+        return count;
+    }
+
+    //число элементов, меньших element
+    constexpr int rank(int element) const {
+        int count = 0;
+        for (int w = 0; w < WORDS; w++) {
+            uint64_t mask = element >= (w + 1) * 64 ? ~uint64_t(0)
+                : element <= w * 64 ? 0 : (uint64_t(1) << (element - w * 64)) - 1;
+            count += popCount(words[w] & mask);
+        }
+        return count;
+    }
+
+    //k-й по возрастанию элемент (k с нуля) или -1
+    constexpr int select(int k) const {
+        for (int w = 0; w < WORDS; w++) {
+            int count = popCount(words[w]);
+            if (k < count) {
+                uint64_t word = words[w];
+                for (int i = 0; i < k; i++) {
+                    word &= word - 1;
+                }
+                return w * 64 + lowestBit(word);
+            }
+            k -= count;
+        }
+        return -1;
+    }
+
+    //наименьший элемент, не меньший element, или -1
+    constexpr int next(int element) const {
+        for (int w = element >> 6; w < WORDS; w++) {
+            uint64_t word = words[w];
+            if (w == (element >> 6)) {
+                word &= ~((uint64_t(1) << (element & 63)) - 1);
+            }
+            if (word != 0) return w * 64 + lowestBit(word);
+        }
+        return -1;
+    }
+
+    //наибольший элемент, меньший element, или -1
+    constexpr int prev(int element) const {
+        for (int w = element >> 6; w >= 0; w--) {
+            uint64_t word = w < WORDS ? words[w] : 0;
+            if (w == (element >> 6)) {
+                word &= (uint64_t(1) << (element & 63)) - 1;
+            }
+            if (word != 0) return w * 64 + highestBit(word);
+        }
+        return -1;
+    }
+
+    static constexpr StaticSet unionSets(const StaticSet& setA, const StaticSet& setB) {
+        StaticSet result;
+        for (int w = 0; w < WORDS; w++) {
+            result.words[w] = setA.words[w] | setB.words[w];
+        }
+        return result;
+    }
+
+    static constexpr StaticSet intersection(const StaticSet& setA, const StaticSet& setB) {
+        StaticSet result;
+        for (int w = 0; w < WORDS; w++) {
+            result.words[w] = setA.words[w] & setB.words[w];
+        }
+        return result;
+    }
+
+    static constexpr StaticSet difference(const StaticSet& setA, const StaticSet& setB) {
+        StaticSet result;
+        for (int w = 0; w < WORDS; w++) {
+            result.words[w] = setA.words[w] & ~setB.words[w];
+        }
+        return result;
+    }
+
+    static constexpr bool isSubset(const StaticSet& setA, const StaticSet& setB) {
+        uint64_t extra = 0;
+        for (int w = 0; w < WORDS; w++) {
+            extra |= setA.words[w] & ~setB.words[w];
+        }
+        return extra == 0;
+    }
+
+    static constexpr bool areEqual(const StaticSet& setA, const StaticSet& setB) {
+        uint64_t diff = 0;
+        for (int w = 0; w < WORDS; w++) {
+            diff |= setA.words[w] ^ setB.words[w];
+        }
+        return diff == 0;
+    }
+};
+
+//пакетная проверка принадлежности по 128-битной карте (16 байт): элемент x есть в карте,
+//если установлен бит x & 7 байта x >> 3; бит i маски – результат для elements[i].
+//Байтовый поиск по карте – это ровно pshufb, поэтому за одну инструкцию проверяется
+//16 (SSE) или 32 (AVX2) элемента; ядро выбирается один раз по возможностям процессора
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SET_BATCH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SET_TARGET_SSE42
+#define SET_TARGET_AVX2
+#else
+#define SET_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define SET_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+using BatchContainsKernel = void (*)(const uint8_t* bitmap, const char* elements, size_t count, uint64_t* mask);
+
+//ядра обрабатывают elements[from..count), чтобы хвост широкого ядра досчитывало более узкое
+inline void batchContainsScalarFrom(const uint8_t* bitmap, const char* elements, size_t from, size_t count, uint64_t* mask) {
+    for (size_t i = from; i < count; i++) {
+        unsigned char x = static_cast<unsigned char>(elements[i]);
+        uint64_t hit = x < 128 ? (bitmap[x >> 3] >> (x & 7)) & 1 : 0;
+        mask[i >> 6] |= hit << (i & 63);
+    }
+}
+
+inline void batchContainsScalar(const uint8_t* bitmap, const char* elements, size_t count, uint64_t* mask) {
+    batchContainsScalarFrom(bitmap, elements, 0, count, mask);
+}
+
+#ifdef SET_BATCH_X86
+SET_TARGET_SSE42
+inline void batchContainsSse42From(const uint8_t* bitmap, const char* elements, size_t from, size_t count, uint64_t* mask) {
+    const __m128i map = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bitmap));
+    const __m128i bitOf = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m128i low3 = _mm_set1_epi8(7);
+    const __m128i low4 = _mm_set1_epi8(15);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i minusOne = _mm_set1_epi8(-1);
+    size_t i = from;
+    for (; i + 16 <= count; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(elements + i));
+        //байты >= 128 вне карты; сдвиг 16-битных слов дает мусор в старших битах, его отсекает low4
+        __m128i inMap = _mm_cmpgt_epi8(x, minusOne);
+        __m128i bytes = _mm_shuffle_epi8(map, _mm_and_si128(_mm_srli_epi16(x, 3), low4));
+        __m128i bitsWanted = _mm_shuffle_epi8(bitOf, _mm_and_si128(x, low3));
+        __m128i miss = _mm_cmpeq_epi8(_mm_and_si128(bytes, bitsWanted), zero);
+        uint64_t hits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_andnot_si128(miss, inMap)));
+        mask[i >> 6] |= hits << (i & 63);
+    }
+    batchContainsScalarFrom(bitmap, elements, i, count, mask);
+}
+
+SET_TARGET_SSE42
+inline void batchContainsSse42(const uint8_t* bitmap, const char* elements, size_t count, uint64_t* mask) {
+    batchContainsSse42From(bitmap, elements, 0, count, mask);
+}
+
+SET_TARGET_AVX2
+inline void batchContainsAvx2(const uint8_t* bitmap, const char* elements, size_t count, uint64_t* mask) {
+    const __m256i map = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bitmap)));
+    const __m256i bitOf = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+        1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m256i low3 = _mm256_set1_epi8(7);
+    const __m256i low4 = _mm256_set1_epi8(15);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i minusOne = _mm256_set1_epi8(-1);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(elements + i));
+        __m256i inMap = _mm256_cmpgt_epi8(x, minusOne);
+        __m256i bytes = _mm256_shuffle_epi8(map, _mm256_and_si256(_mm256_srli_epi16(x, 3), low4));
+        __m256i bitsWanted = _mm256_shuffle_epi8(bitOf, _mm256_and_si256(x, low3));
+        __m256i miss = _mm256_cmpeq_epi8(_mm256_and_si256(bytes, bitsWanted), zero);
+        uint64_t hits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_andnot_si256(miss, inMap)));
+        mask[i >> 6] |= hits << (i & 63);
+    }
+    batchContainsSse42From(bitmap, elements, i, count, mask);
+}
+
+inline bool cpuHasAvx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    //AVX-регистры должны сохраняться операционной системой (OSXSAVE + XCR0)
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return false;
+    if ((_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+inline bool cpuHasSse42() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.2");
+#endif
+}
+#endif
+
+inline BatchContainsKernel batchContainsKernel() {
+#ifdef SET_BATCH_X86
+    static const BatchContainsKernel kernel = cpuHasAvx2() ? batchContainsAvx2
+        : cpuHasSse42() ? batchContainsSse42 : batchContainsScalar;
+    return kernel;
+#else
+    return batchContainsScalar;
+#endif
+}
+
+//трассировка выполнения команд в формате Chrome trace event (открывается в Perfetto
+//или chrome://tracing). Каждый поток пишет интервалы в собственный буфер фиксированного
+//размера без блокировок: единственный писатель публикует событие счётчиком с release.
+//При выключенной трассировке интервал стоит одного чтения атомарного флага
+class Tracer {
+public:
+    static const size_t BUFFER_EVENTS = size_t(1) << 16;
+
+private:
+    struct Event {
+        const char* name;
+        int64_t start;
+        int64_t duration;
+    };
+
+    struct ThreadBuffer {
+        int tid;
+        std::atomic<size_t> count{ 0 };
+        std::vector<Event> events;
+
+        explicit ThreadBuffer(int id) : tid(id), events(BUFFER_EVENTS) {}
+    };
+
+    struct State {
+        std::atomic<bool> enabled{ false };
+        std::atomic<int64_t> sessionStart{ 0 };
+        std::atomic<size_t> dropped{ 0 };
+        std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        //защищает только список буферов: поток регистрируется один раз
+        std::mutex registration;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    };
+
+    static State& state() {
+        static State instance;
+        return instance;
+    }
+
+    //буферы принадлежат трассировщику и переживают свои потоки
+    static ThreadBuffer& buffer() {
+        thread_local ThreadBuffer* local = nullptr;
+        if (local == nullptr) {
+            State& s = state();
+            std::lock_guard<std::mutex> lock(s.registration);
+            s.buffers.push_back(std::make_unique<ThreadBuffer>(static_cast<int>(s.buffers.size()) + 1));
+            local = s.buffers.back().get();
+        }
+        return *local;
+    }
+
+public:
+    static bool enabled() {
+        return state().enabled.load(std::memory_order_relaxed);
+    }
+
+    //наносекунды от запуска программы
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - state().epoch).count();
+    }
+
+    //новая сессия: события прошлых сессий отбрасываются
+    static void start() {
+        State& s = state();
+        {
+            std::lock_guard<std::mutex> lock(s.registration);
+            for (auto& b : s.buffers) b->count.store(0, std::memory_order_relaxed);
+        }
+        s.dropped = 0;
+        s.sessionStart = now();
+        s.enabled = true;
+    }
+
+    static void stop() {
+        state().enabled = false;
+    }
+
+    static void record(const char* name, int64_t start, int64_t end) {
+        ThreadBuffer& b = buffer();
+        size_t n = b.count.load(std::memory_order_relaxed);
+        if (n == BUFFER_EVENTS) {
+            state().dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        b.events[n] = Event{ name, start, end - start };
+        b.count.store(n + 1, std::memory_order_release);
+    }
+
+    static size_t getDropped() {
+        return state().dropped.load();
+    }
+
+    //события сессии в JSON; время в микросекундах. Возвращает число событий
+    static size_t write(std::ostream& out) {
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.registration);
+        int64_t sessionStart = s.sessionStart.load();
+        size_t written = 0;
+
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        out << std::fixed;
+        out.precision(3);
+        for (auto& b : s.buffers) {
+            size_t count = b->count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; i++) {
+                const Event& e = b->events[i];
+                if (e.start < sessionStart) continue;
+                out << (written++ == 0 ? "\n" : ",\n");
+                out << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << b->tid
+                    << ",\"ts\":" << e.start / 1000.0 << ",\"dur\":" << e.duration / 1000.0 << "}";
+            }
+        }
+        out << "\n]}\n";
+        out.unsetf(std::ios::floatfield);
+        out.precision(6);
+        return written;
+    }
+};
+
+//интервал трассировки на время жизни объекта
+class TraceSpan {
+private:
+    const char* name;
+    int64_t start;
+
+public:
+    explicit TraceSpan(const char* spanName) : name(spanName), start(Tracer::enabled() ? Tracer::now() : -1) {}
+
+    ~TraceSpan() {
+        if (start >= 0) Tracer::record(name, start, Tracer::now());
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+class Node {
+public:
+    char data;
+    Node* next;
+
+    Node(char value) : data(value), next(nullptr) {}
+    ~Node() {}
+};
+
+class Set {
+private:
+    //индекс по элементам строится, когда множество вырастает больше порога,
+    //для маленьких множеств линейного прохода по списку достаточно
+    static const int INDEX_THRESHOLD = 16;
+    static const int UNIVERSE = 128;
+    //номер подмножества должен помещаться в uint64_t
+    static const int MAX_INDEXED_SIZE = 63;
+
+public:
+    typedef StaticSet<UNIVERSE> Bitmap;
+    //больше подмножеств за раз не выдают ни срез булеана, ни случайная выборка
+    static constexpr uint64_t MAX_LISTED_SUBSETS = uint64_t(1) << 16;
+
+private:
+    std::string name;
+    Node* first;
+    int size;
+    StaticSet<UNIVERSE> bits;   //битовая карта элементов: rank/select/contains за O(1)
+    Node** index;       //index[x] – узел элемента x, nullptr для малых множеств
+    uint64_t version;   //меняется при каждом изменении; одинаковая версия – одинаковое содержимое
+
+    static void checkListedCount(uint64_t count) {
+        if (count > MAX_LISTED_SUBSETS) {
+            throw std::out_of_range("At most " + std::to_string(MAX_LISTED_SUBSETS) + " subsets can be listed at once");
+        }
+    }
+
+    void checkName(const std::string& n) {
+        if (n.empty()) {
+            throw std::invalid_argument("The name of the set should not be empty.");
+        }
+
+        if (n.length() != 1 || n[0] < 'A' || n[0] > 'Z') {
+            throw std::invalid_argument("The name of the set must be a single character in the A-Z range");
+        }
+    }
+
+    //версии уникальны среди всех множеств программы
+    static uint64_t nextVersion() {
+        static std::atomic<uint64_t> counter{ 0 };
+        return ++counter;
+    }
+
+    //узел, после которого должен стоять element (nullptr – вставка в начало)
+    Node* findPrev(char element) const {
+        if (index != nullptr) {
+            int prev = bits.prev(element);
+            return prev == -1 ? nullptr : index[prev];
+        }
+
+        Node* prev = nullptr;
+        Node* current = first;
+        while (current != nullptr && current->data < element) {
+            prev = current;
+            current = current->next;
+        }
+        return prev;
+    }
+
+    //биномиальные коэффициенты C(n, k) для n ≤ 64
+    static uint64_t binomial(int n, int k) {
+        static const std::vector<std::vector<uint64_t>> table = [] {
+            std::vector<std::vector<uint64_t>> rows(65);
+            for (int i = 0; i <= 64; i++) {
+                rows[i].assign(i + 1, 1);
+                for (int j = 1; j < i; j++) {
+                    rows[i][j] = rows[i - 1][j - 1] + rows[i - 1][j];
+                }
+            }
+            return rows;
+        }();
+
+        if (k < 0 || k > n) return 0;
+        return table[n][k];
+    }
+
+    //C(n, k) для любых n, но не больше limit + 1: для проверки предела перечисления,
+    //когда таблица binomial (n ≤ 64) не подходит
+    static uint64_t binomialAtMost(int n, int k, uint64_t limit) {
+        if (k < 0 || k > n) return 0;
+        k = std::min(k, n - k);
+        uint64_t result = 1;
+        for (int i = 0; i < k; i++) {
+            //C(n, i + 1) = C(n, i) * (n - i) / (i + 1) делится нацело и растёт, пока i < n / 2
+            result = result * static_cast<uint64_t>(n - i) / static_cast<uint64_t>(i + 1);
+            if (result > limit) return limit + 1;
+        }
+        return result;
+    }
+
+    void checkIndexable() const {
+        if (size > MAX_INDEXED_SIZE) {
+            throw std::out_of_range("Set is too large to number its subsets");
+        }
+    }
+
+    //следующее k-сочетание позиций в колексикографическом порядке
+    //(то же, что Gosper's hack над битовой маской, но без ограничения в 64 бита)
+    static bool nextCombination(std::vector<int>& positions, int n) {
+        int k = static_cast<int>(positions.size());
+        for (int i = 0; i < k; i++) {
+            int limit = i + 1 < k ? positions[i + 1] : n;
+            if (positions[i] + 1 < limit) {
+                positions[i]++;
+                for (int j = 0; j < i; j++) {
+                    positions[j] = j;
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static Set subsetFromPositions(const std::vector<char>& elements, const std::vector<int>& positions) {
+        Set subset("S");
+        for (int position : positions) {
+            subset.addElement(elements[position]);
+        }
+        return subset;
+    }
+
+    void buildIndex() {
+        index = new Node*[UNIVERSE]();
+        for (Node* current = first; current != nullptr; current = current->next) {
+            index[static_cast<int>(current->data)] = current;
+        }
+    }
+
+    void clear() {
+        Node* current = first;
+        while (current != nullptr) {
+            Node* next = current->next;
+            delete current;
+            current = next;
+        }
+        first = nullptr;
+        size = 0;
+        bits = StaticSet<UNIVERSE>();
+        delete[] index;
+        index = nullptr;
+    }
+
+    void copyFrom(const Set& other) {
+        Node* otherCurrent = other.first;
+        Node* last = nullptr;
+
+        while (otherCurrent != nullptr) {
+            Node* newNode = new Node(otherCurrent->data);
+
+            if (last == nullptr) {
+                first = newNode;
+            }
+            else {
+                last->next = newNode;
+            }
+            last = newNode;
+            otherCurrent = otherCurrent->next;
+        }
+
+        size = other.size;
+        bits = other.bits;
+        version = other.version;
+        if (other.index != nullptr) {
+            buildIndex();
+        }
+    }
+
+public:
+    //обход элементов по возрастанию
+    class const_iterator {
+    private:
+        const Node* node;
+
+    public:
+        explicit const_iterator(const Node* start) : node(start) {}
+
+        char operator*() const {
+            return node->data;
+        }
+
+        const_iterator& operator++() {
+            node = node->next;
+            return *this;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return node == other.node;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return node != other.node;
+        }
+    };
+
+    Set(const std::string& setName) : first(nullptr), size(0), bits(), index(nullptr), version(nextVersion()) {
+        checkName(setName);
+        name = setName;
+    }
+
+    Set(const Set& other) : name(other.name), first(nullptr), size(0), bits(), index(nullptr), version(other.version) {
+        copyFrom(other);
+    }
+
+    Set& operator=(const Set& other) {
+        if (this != &other) {
+            clear();
+            name = other.name;
+            copyFrom(other);
+        }
+        return *this;
+    }
+
+    ~Set() {
+        clear();
+    }
+
+    std::string getName() const {
+        return name;
+    }
+
+    void setName(const std::string& newName) {
+        checkName(newName);
+        name = newName;
+    }
+
+    uint64_t getVersion() const {
+        return version;
+    }
+
+    void addElement(char element) {
+        if (!isElement(element)) {
+            throw std::invalid_argument("Element must be a printable character");
+        }
+
+        if (bits.contains(element)) return;
+
+        Node* newNode = new Node(element);
+        Node* prev = findPrev(element);
+
+        if (prev == nullptr) {
+            newNode->next = first;
+            first = newNode;
+        }
+        else {
+            newNode->next = prev->next;
+            prev->next = newNode;
+        }
+
+        bits.insert(element);
+        size++;
+        version = nextVersion();
+
+        if (index != nullptr) {
+            index[static_cast<int>(element)] = newNode;
+        }
+        else if (size > INDEX_THRESHOLD) {
+            buildIndex();
+        }
+    }
+
+    void removeElement(char element) {
+        if (!contains(element)) return;
+
+        Node* prev = findPrev(element);
+        Node* temp = prev == nullptr ? first : prev->next;
+
+        if (prev == nullptr) {
+            first = temp->next;
+        }
+        else {
+            prev->next = temp->next;
+        }
+        delete temp;
+
+        bits.erase(element);
+        size--;
+        version = nextVersion();
+
+        if (index != nullptr) {
+            index[static_cast<int>(element)] = nullptr;
+        }
+    }
+
+    bool contains(char element) const {
+        return isElement(element) && bits.contains(element);
+    }
+
+    //пакетная проверка: бит i маски – есть ли elements[i] в множестве;
+    //mask должна вмещать (count + 63) / 64 слов
+    void containsBatch(const char* elements, size_t count, uint64_t* mask) const {
+        uint8_t bitmap[UNIVERSE / 8];
+        for (int b = 0; b < UNIVERSE / 8; b++) {
+            bitmap[b] = static_cast<uint8_t>(bits.word(b >> 3) >> ((b & 7) * 8));
+        }
+        std::fill(mask, mask + (count + 63) / 64, 0);
+        batchContainsKernel()(bitmap, elements, count, mask);
+    }
+
+    std::vector<uint64_t> containsBatch(const std::string& elements) const {
+        std::vector<uint64_t> mask((elements.size() + 63) / 64);
+        containsBatch(elements.data(), elements.size(), mask.data());
+        return mask;
+    }
+
+    int getSize() const {
+        return size;
+    }
+
+    const Bitmap& getBits() const {
+        return bits;
+    }
+
+    //элементы множеств – печатные символы ASCII
+    static bool isElement(char element) {
+        return element >= 32 && element <= 126;
+    }
+
+    //число элементов, меньших element
+    int rank(char element) const {
+        return bits.rank(static_cast<unsigned char>(element));
+    }
+
+    //k-й по возрастанию элемент (k с нуля)
+    char select(int k) const {
+        if (k < 0 || k >= size) {
+            throw std::out_of_range("Index is out of the set bounds");
+        }
+
+        return static_cast<char>(bits.select(k));
+    }
+
+    //элементы из диапазона [lo, hi] по возрастанию
+    std::vector<char> getRange(char lo, char hi) const {
+        std::vector<char> elements;
+        int from = static_cast<unsigned char>(lo);
+        int to = std::min(static_cast<int>(static_cast<unsigned char>(hi)), UNIVERSE - 1);
+        if (from > to) return elements;
+
+        for (int e = bits.next(from); e != -1 && e <= to; e = e + 1 < UNIVERSE ? bits.next(e + 1) : -1) {
+            elements.push_back(static_cast<char>(e));
+        }
+        return elements;
+    }
+
+    void print(std::ostream& out = std::cout) const {
+        TraceSpan span("print");
+        out << name << " = {";
+        Node* current = first;
+        while (current != nullptr) {
+            out << current->data;
+            if (current->next != nullptr) out << ", ";
+            current = current->next;
+        }
+        out << "}" << std::endl;
+    }
+
+    const_iterator begin() const {
+        return const_iterator(first);
+    }
+
+    const_iterator end() const {
+        return const_iterator(nullptr);
+    }
+
+    //множество с готовой битовой картой: узлы дописываются в хвост по возрастанию
+    static Set fromBits(const std::string& setName, const Bitmap& elements) {
+        Set result(setName);
+        Node* last = nullptr;
+        for (int e = elements.next(0); e != -1; e = e + 1 < UNIVERSE ? elements.next(e + 1) : -1) {
+            Node* newNode = new Node(static_cast<char>(e));
+            if (last == nullptr) {
+                result.first = newNode;
+            }
+            else {
+                last->next = newNode;
+            }
+            last = newNode;
+        }
+
+        result.bits = elements;
+        result.size = elements.size();
+        result.version = nextVersion();
+        if (result.size > INDEX_THRESHOLD) {
+            result.buildIndex();
+        }
+        return result;
+    }
+
+    //занимаемая память: сам объект, узлы списка и индекс
+    size_t memoryUsage() const {
+        return sizeof(Set) + name.capacity() + static_cast<size_t>(size) * sizeof(Node)
+            + (index != nullptr ? UNIVERSE * sizeof(Node*) : 0);
+    }
+
+    std::vector<char> getElements() const {
+        std::vector<char> elements;
+        Node* current = first;
+        while (current != nullptr) {
+            elements.push_back(current->data);
+            current = current->next;
+        }
+        return elements;
+    }
+
+    std::vector<Set> powerSet() const {
+        TraceSpan span("powerSet");
+        std::vector<Set> result;
+        std::vector<char> elements = getElements();
+        int n = elements.size();
+
+        // 2^n подмножеств
+        for (int i = 0; i < (1 << n); i++) {
+            Set subset("S");
+            for (int j = 0; j < n; j++) {
+                if (i & (1 << j)) {
+                    subset.addElement(elements[j]);
+                }
+            }
+            result.push_back(subset);
+        }
+        return result;
+    }
+
+    //комбинаторный порядок: сначала по размеру, внутри размера – колексикографически;
+    //номер вычисляется через комбинаторную систему счисления за O(n)
+    uint64_t subsetIndex(const Set& subset) const {
+        checkIndexable();
+        if (!isSubset(subset, *this)) {
+            throw std::invalid_argument("Set " + subset.name + " is not a subset of " + name);
+        }
+
+        uint64_t result = 0;
+        for (int j = 0; j < subset.size; j++) {
+            result += binomial(size, j);
+        }
+
+        int i = 1;
+        for (Node* current = subset.first; current != nullptr; current = current->next, i++) {
+            result += binomial(rank(current->data), i);
+        }
+        return result;
+    }
+
+    Set subsetAt(uint64_t index) const {
+        checkIndexable();
+        if (index >> size) {
+            throw std::out_of_range("Subset index is out of the power set bounds");
+        }
+
+        int k = 0;
+        while (index >= binomial(size, k)) {
+            index -= binomial(size, k);
+            k++;
+        }
+
+        std::vector<int> positions(k);
+        int c = size - 1;
+        for (int i = k; i >= 1; i--, c--) {
+            while (binomial(c, i) > index) c--;
+            positions[i - 1] = c;
+            index -= binomial(c, i);
+        }
+        return subsetFromPositions(getElements(), positions);
+    }
+
+    //count подмножеств, начиная с номера from, без построения предыдущих
+    std::vector<Set> powerSetSlice(uint64_t from, uint64_t count) const {
+        checkListedCount(count);
+        std::vector<Set> result;
+        if (count == 0) return result;
+
+        Set start = subsetAt(from);
+        std::vector<char> elements = getElements();
+        std::vector<int> positions;
+        for (Node* current = start.first; current != nullptr; current = current->next) {
+            positions.push_back(rank(current->data));
+        }
+
+        while (true) {
+            result.push_back(subsetFromPositions(elements, positions));
+            if (result.size() == count) break;
+
+            if (!nextCombination(positions, size)) {
+                int k = static_cast<int>(positions.size()) + 1;
+                if (k > size) break;
+                positions.resize(k);
+                for (int j = 0; j < k; j++) {
+                    positions[j] = j;
+                }
+            }
+        }
+        return result;
+    }
+
+    std::vector<Set> kSubsets(int k) const {
+        TraceSpan span("kSubsets");
+        checkListedCount(binomialAtMost(size, k, MAX_LISTED_SUBSETS));
+        std::vector<Set> result;
+        if (k < 0 || k > size) return result;
+
+        std::vector<char> elements = getElements();
+        std::vector<int> positions(k);
+        for (int j = 0; j < k; j++) {
+            positions[j] = j;
+        }
+
+        do {
+            result.push_back(subsetFromPositions(elements, positions));
+        } while (nextCombination(positions, size));
+        return result;
+    }
+
+    //каждый элемент входит с вероятностью 1/2 – все 2^n подмножеств равновероятны
+    std::vector<Set> randomSubsets(int count, std::mt19937_64& rng) const {
+        checkListedCount(count < 0 ? 0 : static_cast<uint64_t>(count));
+        std::vector<Set> result;
+        std::vector<char> elements = getElements();
+
+        for (int i = 0; i < count; i++) {
+            Set subset("S");
+            uint64_t randomBits = 0;
+            for (int j = 0; j < size; j++) {
+                if (j % 64 == 0) randomBits = rng();
+                if (randomBits & 1) subset.addElement(elements[j]);
+                randomBits >>= 1;
+            }
+            result.push_back(subset);
+        }
+        return result;
+    }
+
+    //операции над множествами выполняются над битовыми картами (StaticSet),
+    //список результата строится за один проход по возрастанию
+    static Set unionSets(const Set& setA, const Set& setB) {
+        return fromBits("T", StaticSet<UNIVERSE>::unionSets(setA.bits, setB.bits));
+    }
+
+    static Set intersection(const Set& setA, const Set& setB) {
+        return fromBits("T", StaticSet<UNIVERSE>::intersection(setA.bits, setB.bits));
+    }
+
+    static Set difference(const Set& setA, const Set& setB) {
+        return fromBits("T", StaticSet<UNIVERSE>::difference(setA.bits, setB.bits));
+    }
+
+    static bool isSubset(const Set& setA, const Set& setB) {
+        return StaticSet<UNIVERSE>::isSubset(setA.bits, setB.bits);
+    }
+
+    static bool areEqual(const Set& setA, const Set& setB) {
+        return StaticSet<UNIVERSE>::areEqual(setA.bits, setB.bits);
+    }
+};
+
+//версии множеств A-Z для снимков (MVCC). Каталог версии – неизменяемый массив указателей
+//на неизменяемые битовые карты; изменение одного множества копирует каталог (26 указателей)
+//и создаёт одну новую карту, остальные разделяются со старыми версиями, поэтому снимок –
+//копия shared_ptr за O(1). Журнал версий хранит слабые ссылки: версия доступна, пока её
+//держит снимок или читатель, после чего освобождается вместе с неразделёнными картами
+class SetHistory {
+public:
+    static const int SLOTS = 26;
+
+    struct Catalog {
+        uint64_t version = 0;
+        std::shared_ptr<const Set::Bitmap> sets[SLOTS];    //nullptr – множества нет
+    };
+
+    typedef std::shared_ptr<const Catalog> Snapshot;
+
+private:
+    Snapshot head;
+    std::map<uint64_t, std::weak_ptr<const Catalog>> versions;
+    std::map<uint64_t, Snapshot> pinned;
+
+    //записи об освобождённых версиях убираются из журнала
+    void collect();
+
+public:
+    SetHistory();
+
+    uint64_t getVersion() const {
+        return head->version;
+    }
+
+    Snapshot getHead() const {
+        return head;
+    }
+
+    //новая версия, в которой множество slot заменено на elements (nullptr – удалено);
+    //изменение без изменения содержимого версию не создаёт
+    void commit(int slot, const Set::Bitmap* elements);
+
+    //nullptr, если версия уже освобождена
+    Snapshot find(uint64_t version) const;
+
+    Snapshot pin();
+    bool unpin(uint64_t version);
+
+    const std::map<uint64_t, Snapshot>& getPinned() const {
+        return pinned;
+    }
+
+    size_t getLiveVersions() const {
+        return versions.size();
+    }
+};
+
+//коды результата встраиваемого API
+enum SetStatus {
+    SET_OK, SET_INVALID_NAME, SET_INVALID_ELEMENT, SET_INVALID_OPERATION, SET_NOT_FOUND,
+    SET_ALREADY_EXISTS, SET_VERSION_NOT_AVAILABLE
+};
+
+const char* statusMessage(SetStatus status);
+
+//значение или код ошибки (в духе std::expected)
+template <typename T>
+struct SetResult {
+    SetStatus status = SET_OK;
+    T value{};
+
+    bool ok() const {
+        return status == SET_OK;
+    }
+};
+
+//встраиваемое API множеств A-Z: без консольного вывода и без исключений (кроме
+//std::bad_alloc) – аргументы проверяются до обращения к Set, ошибки возвращаются кодами.
+//Изменения записываются в версии для снимков. SetManager – командный интерфейс над ним
+class SetStore {
+private:
+    std::vector<Set> sets;
+    SetHistory history;
+
+    static bool validName(char name) {
+        return name >= 'A' && name <= 'Z';
+    }
+
+    SetStatus bitsOf(char name, const Set::Bitmap*& bits) const;
+
+    //снимок удерживается вызывающим на время чтения
+    SetStatus bitsAt(uint64_t version, char name, SetHistory::Snapshot& snapshot, const Set::Bitmap*& bits) const;
+
+public:
+    //операции над битовыми картами, откуда бы они ни были взяты (текущие множества, версия,
+    //разделяемая память): '+', '&', '-' – множество-результат, '<', '=' – проверка
+    static SetResult<Set::Bitmap> apply(char operation, const Set::Bitmap& bitsA, const Set::Bitmap& bitsB);
+    static SetResult<bool> test(char operation, const Set::Bitmap& bitsA, const Set::Bitmap& bitsB);
+
+    static bool isTest(char operation) {
+        return operation == '<' || operation == '=';
+    }
+
+    const std::vector<Set>& getSets() const {
+        return sets;
+    }
+
+    const SetHistory& getHistory() const {
+        return history;
+    }
+
+    int indexOf(char name) const;
+
+    SetStatus createSet(char name);
+    SetStatus deleteSet(char name);
+    SetStatus addElement(char name, char element);
+    SetStatus removeElement(char name, char element);
+
+    SetResult<bool> contains(char name, char element) const;
+
+    //mask должна вмещать (count + 63) / 64 слов
+    SetStatus containsBatch(char name, const char* elements, size_t count, uint64_t* mask) const;
+
+    SetResult<Set::Bitmap> getElements(char name) const;
+    SetResult<Set::Bitmap> combine(char operation, char nameA, char nameB) const;
+    SetResult<bool> compare(char operation, char nameA, char nameB) const;
+
+    //снимок текущего состояния; в результате – его версия
+    SetResult<uint64_t> snapshot();
+    SetStatus release(uint64_t version);
+
+    SetResult<Set::Bitmap> getElementsAt(char name, uint64_t version) const;
+    SetResult<Set::Bitmap> combineAt(char operation, char nameA, char nameB, uint64_t version) const;
+    SetResult<bool> compareAt(char operation, char nameA, char nameB, uint64_t version) const;
+};
+
+#endif
@@ -0,0 +1,162 @@
+//проверки представлений множеств и пула потоков на случайных данных: результат каждой операции
+//сравнивается с std::set_* над отсортированными массивами
+#include "int_sets.h"
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <atomic>
+#include <thread>
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+//size различных значений из [0, range), по возрастанию
+static std::vector<uint32_t> randomSorted(size_t size, uint64_t range, std::mt19937_64& rng) {
+    std::vector<uint32_t> values;
+    values.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+        values.push_back(static_cast<uint32_t>(rng() % range));
+    }
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    return values;
+}
+
+static std::vector<uint32_t> expected(char operation, const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+    std::vector<uint32_t> result;
+    if (operation == '+') std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    if (operation == '&') std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    if (operation == '-') std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+
+//пары входов: пустые, одинаковые, вложенные, с крайним значением UINT32_MAX и разного
+//размера, чтобы skipTo перескакивал целые блоки
+static std::vector<std::pair<std::vector<uint32_t>, std::vector<uint32_t>>> inputPairs(std::mt19937_64& rng) {
+    std::vector<std::pair<std::vector<uint32_t>, std::vector<uint32_t>>> pairs;
+    std::vector<uint32_t> large = randomSorted(20000, 1000000, rng);
+    pairs.push_back({ {}, {} });
+    pairs.push_back({ {}, large });
+    pairs.push_back({ large, {} });
+    pairs.push_back({ large, large });
+    pairs.push_back({ { 0, 7, UINT32_MAX }, { 7, UINT32_MAX } });
+    for (int round = 0; round < 20; round++) {
+        size_t sizeA = rng() % 5000;
+        size_t sizeB = round % 2 == 0 ? rng() % 50 : rng() % 5000;
+        uint64_t range = round % 3 == 0 ? uint64_t(1) << 32 : 20000;
+        pairs.push_back({ randomSorted(sizeA, range, rng), randomSorted(sizeB, range, rng) });
+    }
+    std::vector<uint32_t> subset;
+    for (size_t i = 0; i < large.size(); i += 3) subset.push_back(large[i]);
+    pairs.push_back({ subset, large });
+    return pairs;
+}
+
+template <typename Encoded>
+static void testMerges(const std::string& name, std::mt19937_64& rng) {
+    for (const auto& input : inputPairs(rng)) {
+        const std::vector<uint32_t>& a = input.first;
+        const std::vector<uint32_t>& b = input.second;
+        std::string what = name + " " + std::to_string(a.size()) + "/" + std::to_string(b.size());
+        Encoded setA = Encoded::encode(a);
+        Encoded setB = Encoded::encode(b);
+
+        check(setA.decode() == a, what + " decode");
+        check(Encoded::unionSets(setA, setB).decode() == expected('+', a, b), what + " union");
+        check(Encoded::intersection(setA, setB).decode() == expected('&', a, b), what + " intersection");
+        check(Encoded::difference(setA, setB).decode() == expected('-', a, b), what + " difference");
+        check(Encoded::isSubset(setA, setB) == std::includes(b.begin(), b.end(), a.begin(), a.end()), what + " subset");
+        check(Encoded::areEqual(setA, setB) == (a == b), what + " equal");
+
+        //skipTo находит первое значение не меньше цели, в том числе за пределами текущего блока
+        for (int probe = 0; probe < 50 && !a.empty(); probe++) {
+            uint32_t target = a[rng() % a.size()] + static_cast<uint32_t>(rng() % 3);
+            typename Encoded::Cursor cursor(setA);
+            cursor.skipTo(target);
+            auto it = std::lower_bound(a.begin(), a.end(), target);
+            check(it == a.end() ? cursor.atEnd() : !cursor.atEnd() && cursor.value() == *it, what + " skipTo");
+        }
+    }
+}
+
+//каждая задача выполняется ровно один раз при повторных запусках одного пула,
+//вложенных вызовах и запусках из нескольких потоков сразу
+static void testWorkPool() {
+    WorkPool pool(8);
+    for (size_t tasks = 0; tasks < 300; tasks += 7) {
+        std::vector<std::atomic<int>> hits(tasks);
+        pool.run(tasks, [&](size_t task) { hits[task]++; });
+        bool once = true;
+        for (auto& hit : hits) once = once && hit == 1;
+        check(once, "work pool " + std::to_string(tasks) + " tasks");
+    }
+
+    std::vector<std::atomic<int>> nested(16 * 4);
+    pool.run(16, [&](size_t outer) {
+        pool.run(4, [&](size_t inner) { nested[outer * 4 + inner]++; });
+    });
+    bool once = true;
+    for (auto& hit : nested) once = once && hit == 1;
+    check(once, "work pool nested run");
+
+    std::vector<std::atomic<int>> shared(2 * 1000);
+    std::thread other([&] { pool.run(1000, [&](size_t task) { shared[1000 + task]++; }); });
+    pool.run(1000, [&](size_t task) { shared[task]++; });
+    other.join();
+    once = true;
+    for (auto& hit : shared) once = once && hit == 1;
+    check(once, "work pool concurrent run");
+}
+
+//входы выше PARALLEL_THRESHOLD, чтобы слияние шло по частям: случайные, сильно разного
+//размера и пересекающиеся сплошные диапазоны (равные значения на границах частей)
+static void testSortedSet(std::mt19937_64& rng) {
+    std::vector<std::pair<std::vector<uint32_t>, std::vector<uint32_t>>> pairs;
+    pairs.push_back({ randomSorted(700000, uint64_t(1) << 22, rng), randomSorted(700000, uint64_t(1) << 22, rng) });
+    pairs.push_back({ randomSorted(1200000, uint64_t(1) << 32, rng), randomSorted(500, uint64_t(1) << 32, rng) });
+    std::vector<uint32_t> low, high;
+    for (uint32_t value = 0; value < 900000; value++) low.push_back(value);
+    for (uint32_t value = 300000; value < 1200000; value++) high.push_back(value);
+    pairs.push_back({ low, high });
+    pairs.push_back({ low, low });
+
+    for (const auto& input : pairs) {
+        const std::vector<uint32_t>& a = input.first;
+        const std::vector<uint32_t>& b = input.second;
+        std::string what = "sorted set " + std::to_string(a.size()) + "/" + std::to_string(b.size());
+        SortedSet setA(a);
+        SortedSet setB(b);
+
+        check(SortedSet::unionSets(setA, setB).getValues() == expected('+', a, b), what + " union");
+        check(SortedSet::intersection(setA, setB).getValues() == expected('&', a, b), what + " intersection");
+        check(SortedSet::difference(setA, setB).getValues() == expected('-', a, b), what + " difference");
+        check(SortedSet::difference(setB, setA).getValues() == expected('-', b, a), what + " reverse difference");
+        check(SortedSet::isSubset(setA, setB) == std::includes(b.begin(), b.end(), a.begin(), a.end()), what + " subset");
+        check(SortedSet::areEqual(setA, setB) == (a == b), what + " equal");
+    }
+}
+
+int main() {
+    std::mt19937_64 rng(2024);
+    testMerges<VarintSet>("varint", rng);
+    testMerges<EliasFanoSet>("elias-fano", rng);
+    testWorkPool();
+    testSortedSet(rng);
+
+    if (failures > 0) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}